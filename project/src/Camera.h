@@ -40,6 +40,10 @@ namespace dae
 		Matrix viewMatrix{};
 		Matrix projectionMatrix{};
 		bool isProjectionMatrixDirty{ true };
+		//Near plane at depth 1 and far plane at 0, float depth keeps its precision far away that way
+		bool isReversedZ{ false };
+		//Bumped whenever the view or projection matrix changes, so data derived from them can tell it is stale
+		uint32_t version{};
 
 		void Initialize(float _width, float _height, float _fovAngle = 90.f, Vector3 _origin = { 0.f, 0.f, 0.f })
 		{
@@ -50,6 +54,7 @@ namespace dae
 			origin = _origin;
 
 			isProjectionMatrixDirty = true; // Mark dirty on initialization
+			++version;
 		}
 
 		void CalculateViewMatrix()
@@ -68,8 +73,12 @@ namespace dae
 		{
 			if (isProjectionMatrixDirty)
 			{
-				projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, width / height, .1f, 100.f);
+				constexpr float nearPlane{ .1f };
+				constexpr float farPlane{ 100.f };
+				projectionMatrix = isReversedZ ? Matrix::CreatePerspectiveFovLH(fov, width / height, farPlane, nearPlane)
+					: Matrix::CreatePerspectiveFovLH(fov, width / height, nearPlane, farPlane);
 				isProjectionMatrixDirty = false; // Reset flag after update
+				++version;
 			}
 		}
 
@@ -89,6 +98,10 @@ namespace dae
 
 			const float deltaTime = pTimer->GetElapsed();
 
+			const Vector3 previousOrigin{ origin };
+			const float previousPitch{ totalPitch };
+			const float previousYaw{ totalYaw };
+
 			Vector3 velocity{ 30.f, 15.f, 30.f };
 			constexpr float rotationVelocity{ 0.1f * PI / 180.0f };
 
@@ -132,6 +145,10 @@ namespace dae
 
 			// Update Matrices
 			CalculateViewMatrix();
+			if (origin.x != previousOrigin.x || origin.y != previousOrigin.y || origin.z != previousOrigin.z || totalPitch != previousPitch || totalYaw != previousYaw)
+			{
+				++version;
+			}
 
 			// Calculate projection matrix only if dirty
 			CalculateProjectionMatrix();
@@ -147,6 +164,15 @@ namespace dae
 			}
 		}
 
+		void SetReversedZ(bool isReversed)
+		{
+			if (isReversedZ != isReversed)
+			{
+				isReversedZ = isReversed;
+				isProjectionMatrixDirty = true; // Mark dirty if the depth direction changes
+			}
+		}
+
 		void SetViewportSize(float newWidth, float newHeight)
 		{
 			if (width != newWidth || height != newHeight)
@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "Clipper.h"
+
+namespace dae
+{
+	namespace
+	{
+		//All attributes are linear in clip space
+		Vertex_Out LerpVertex(const Vertex_Out& from, const Vertex_Out& to, float t)
+		{
+			Vertex_Out vertex;
+			vertex.position = from.position + (to.position - from.position) * t;
+			vertex.uv = from.uv + (to.uv - from.uv) * t;
+			vertex.normal = from.normal + (to.normal - from.normal) * t;
+			vertex.tangent = from.tangent + (to.tangent - from.tangent) * t;
+			vertex.viewDirection = from.viewDirection + (to.viewDirection - from.viewDirection) * t;
+			return vertex;
+		}
+	}
+
+	void Clipper::SetViewport(int width, int height)
+	{
+		m_GuardBandX = 1.f + 2.f * GUARD_BAND_PIXELS / float(width);
+		m_GuardBandY = 1.f + 2.f * GUARD_BAND_PIXELS / float(height);
+	}
+
+	float Clipper::GetPlaneDistance(const Vector4& position, int plane) const
+	{
+		switch (plane)
+		{
+		case 0: return m_IsReversedZ ? position.w - position.z : position.z; //near
+		case 1: return position.x + m_GuardBandX * position.w;
+		case 2: return m_GuardBandX * position.w - position.x;
+		case 3: return position.y + m_GuardBandY * position.w;
+		default: return m_GuardBandY * position.w - position.y;
+		}
+	}
+
+	int Clipper::ClipTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2)
+	{
+		const Vector4& p0 = v0.position;
+		const Vector4& p1 = v1.position;
+		const Vector4& p2 = v2.position;
+
+		// Trivial reject: all vertices outside the same frustum plane
+		if ((p0.x > p0.w && p1.x > p1.w && p2.x > p2.w) || (p0.x < -p0.w && p1.x < -p1.w && p2.x < -p2.w) ||
+			(p0.y > p0.w && p1.y > p1.w && p2.y > p2.w) || (p0.y < -p0.w && p1.y < -p1.w && p2.y < -p2.w) ||
+			(p0.z < 0.f && p1.z < 0.f && p2.z < 0.f) || (p0.z > p0.w && p1.z > p1.w && p2.z > p2.w)) return 0;
+
+		m_pPolygon[0] = &v0;
+		m_pPolygon[1] = &v1;
+		m_pPolygon[2] = &v2;
+		int numVertices = 3;
+		m_NumScratch = 0;
+
+		for (int plane = 0; plane < NUM_CLIP_PLANES; ++plane)
+		{
+			float distances[MAX_VERTICES];
+			bool isAnyOutside = false;
+			for (int vertex = 0; vertex < numVertices; ++vertex)
+			{
+				distances[vertex] = GetPlaneDistance(m_pPolygon[vertex]->position, plane);
+				isAnyOutside |= distances[vertex] < 0.f;
+			}
+
+			// Common case: the polygon is inside the guard band, nothing to do for this plane
+			if (!isAnyOutside) continue;
+
+			// Sutherland-Hodgman against a single plane
+			int numClipped = 0;
+			for (int vertex = 0; vertex < numVertices; ++vertex)
+			{
+				const int next = (vertex + 1) % numVertices;
+				const bool isInside = distances[vertex] >= 0.f;
+				const bool isNextInside = distances[next] >= 0.f;
+
+				if (isInside)
+				{
+					m_pClipped[numClipped++] = m_pPolygon[vertex];
+				}
+				if (isInside != isNextInside)
+				{
+					const float t = distances[vertex] / (distances[vertex] - distances[next]);
+					m_Scratch[m_NumScratch] = LerpVertex(*m_pPolygon[vertex], *m_pPolygon[next], t);
+					m_pClipped[numClipped++] = &m_Scratch[m_NumScratch++];
+				}
+			}
+
+			if (numClipped < 3) return 0;
+
+			std::copy(m_pClipped, m_pClipped + numClipped, m_pPolygon);
+			numVertices = numClipped;
+		}
+
+		return numVertices;
+	}
+}
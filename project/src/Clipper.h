@@ -0,0 +1,51 @@
+#pragma once
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Screen coordinates may reach this far outside the viewport before x/y get clipped
+	constexpr float GUARD_BAND_PIXELS{ 4096.f };
+
+	//Clips triangles in homogeneous clip space, before the perspective divide.
+	//The near plane is always clipped, x/y only once a triangle leaves the guard band, far is left to the depth test.
+	//All scratch vertices live inside the object, every worker uses its own clipper.
+	class Clipper final
+	{
+	public:
+		//Every clip plane adds at most one vertex to the polygon
+		static constexpr int NUM_CLIP_PLANES{ 5 };
+		static constexpr int MAX_VERTICES{ 3 + NUM_CLIP_PLANES };
+
+		Clipper() = default;
+		~Clipper() = default;
+
+		Clipper(const Clipper& other) = delete;
+		Clipper& operator=(const Clipper& rhs) = delete;
+		Clipper(Clipper&& other) = delete;
+		Clipper& operator=(Clipper&& rhs) = delete;
+
+		void SetViewport(int width, int height);
+		//Reversed-Z puts the near plane at z = w instead of z = 0
+		void SetReversedZ(bool isReversedZ) { m_IsReversedZ = isReversedZ; }
+
+		//Returns the vertex count of the clipped polygon (0 when nothing is left), vertices form a triangle fan
+		int ClipTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2);
+		const Vertex_Out& GetVertex(int index) const { return *m_pPolygon[index]; }
+
+	private:
+		//Guard band extents in clip space, as a multiple of w
+		float m_GuardBandX{ 1.f };
+		float m_GuardBandY{ 1.f };
+		bool m_IsReversedZ{ false };
+
+		//Polygon is kept as pointers so unclipped triangles never get copied
+		const Vertex_Out* m_pPolygon[MAX_VERTICES]{};
+		const Vertex_Out* m_pClipped[MAX_VERTICES]{};
+
+		//Intersections created while clipping, every plane creates at most two
+		Vertex_Out m_Scratch[2 * NUM_CLIP_PLANES]{};
+		int m_NumScratch{};
+
+		float GetPlaneDistance(const Vector4& position, int plane) const;
+	};
+}
@@ -0,0 +1,135 @@
+#include "pch.h"
+#include "ColorBuffer.h"
+#include <emmintrin.h>
+
+namespace dae
+{
+	namespace
+	{
+		//Four halves (one RGBA pixel) widened to floats, clamped and scaled to [0, 255] as BGRA lanes
+		__m128i ConvertHalfPixel(__m128i halves)
+		{
+			const __m128i sign = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x8000)), 16);
+			const __m128i magnitude = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x7FFF)), 13);
+			__m128 color = _mm_mul_ps(_mm_castsi128_ps(_mm_or_si128(sign, magnitude)), _mm_set1_ps(5.19229686e33f));
+
+			color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.f));
+			const __m128i channels = _mm_cvttps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.f)));
+			return _mm_shuffle_epi32(channels, _MM_SHUFFLE(3, 0, 1, 2));
+		}
+	}
+
+	void ConvertBGRA8(const uint32_t* pSource, uint32_t* pDestination, int count, int redShift, int greenShift, int blueShift, uint32_t alphaMask)
+	{
+		const __m128i channelMask = _mm_set1_epi32(0xFF);
+		const __m128i alpha = _mm_set1_epi32(int(alphaMask));
+		const __m128i red = _mm_cvtsi32_si128(redShift);
+		const __m128i green = _mm_cvtsi32_si128(greenShift);
+		const __m128i blue = _mm_cvtsi32_si128(blueShift);
+
+		int pixelIndex = 0;
+		for (; pixelIndex + 4 <= count; pixelIndex += 4)
+		{
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSource + pixelIndex));
+
+			__m128i converted = _mm_or_si128(alpha, _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(pixels, 16), channelMask), red));
+			converted = _mm_or_si128(converted, _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(pixels, 8), channelMask), green));
+			converted = _mm_or_si128(converted, _mm_sll_epi32(_mm_and_si128(pixels, channelMask), blue));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDestination + pixelIndex), converted);
+		}
+
+		for (; pixelIndex < count; ++pixelIndex)
+		{
+			const uint32_t pixel = pSource[pixelIndex];
+			pDestination[pixelIndex] = alphaMask | (((pixel >> 16) & 0xFF) << redShift) | (((pixel >> 8) & 0xFF) << greenShift) | ((pixel & 0xFF) << blueShift);
+		}
+	}
+
+	ColorBuffer::ColorBuffer(const PixelLayout& layout, ColorFormat format, uint32_t* pExternalPixels, bool isHugePageRequested) :
+		m_Layout{ layout },
+		m_Format{ format }
+	{
+		const size_t numPixels = size_t(layout.GetPixelCount());
+		if (format == ColorFormat::BGRA8)
+		{
+			if (pExternalPixels == nullptr || !layout.IsLinear())
+			{
+				m_pOwnedPixels = std::make_unique<PixelStorage>(numPixels * sizeof(uint32_t), isHugePageRequested);
+				pExternalPixels = m_pOwnedPixels->GetData<uint32_t>();
+			}
+			m_pPixelsBGRA8 = pExternalPixels;
+		}
+		else
+		{
+			m_pOwnedPixels = std::make_unique<PixelStorage>(numPixels * 4 * sizeof(uint16_t), isHugePageRequested);
+			m_pPixelsRGBA16F = m_pOwnedPixels->GetData<uint16_t>();
+		}
+	}
+
+	void ColorBuffer::Fill(int firstIndex, int lastIndex, const ColorRGB& color)
+	{
+		if (m_Format == ColorFormat::BGRA8)
+		{
+			std::fill(m_pPixelsBGRA8 + firstIndex, m_pPixelsBGRA8 + lastIndex, PackBGRA8(color));
+			return;
+		}
+
+		const uint16_t pixel[4]{ FloatToHalf(color.r), FloatToHalf(color.g), FloatToHalf(color.b), HALF_ONE };
+		for (int pixelIndex = firstIndex; pixelIndex < lastIndex; ++pixelIndex)
+		{
+			std::copy(pixel, pixel + 4, &m_pPixelsRGBA16F[size_t(pixelIndex) * 4]);
+		}
+	}
+
+	void ColorBuffer::Resolve(int firstPixel, int lastPixel, uint32_t* pDestination) const
+	{
+		if (m_Layout.IsLinear())
+		{
+			ResolveRun(firstPixel, lastPixel - firstPixel, pDestination + firstPixel);
+			return;
+		}
+
+		// Linearize: the row crosses one block after the other
+		const int width = m_Layout.GetWidth();
+		const int py = firstPixel / width;
+		const int minX = firstPixel - py * width;
+		const int maxX = lastPixel - py * width;
+		uint32_t* pRun = pDestination + firstPixel;
+		m_Layout.ForEachRowRun(minX, py, maxX, py + 1, [&](int firstIndex, int lastIndex)
+		{
+			ResolveRun(firstIndex, lastIndex - firstIndex, pRun);
+			pRun += lastIndex - firstIndex;
+		});
+	}
+
+	void ColorBuffer::ResolveRun(int firstIndex, int count, uint32_t* pDestination) const
+	{
+		if (m_Format == ColorFormat::BGRA8)
+		{
+			if (m_pPixelsBGRA8 + firstIndex != pDestination)
+			{
+				std::copy(m_pPixelsBGRA8 + firstIndex, m_pPixelsBGRA8 + firstIndex + count, pDestination);
+			}
+			return;
+		}
+
+		// Four pixels (sixteen halves) per iteration, packed down to bytes with saturation
+		const __m128i zero = _mm_setzero_si128();
+		const uint16_t* pHalves = m_pPixelsRGBA16F + size_t(firstIndex) * 4;
+		int pixel = 0;
+		for (; pixel + 4 <= count; pixel += 4)
+		{
+			const __m128i halves01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHalves + size_t(pixel) * 4));
+			const __m128i halves23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHalves + size_t(pixel) * 4 + 8));
+
+			const __m128i pixels01 = _mm_packs_epi32(ConvertHalfPixel(_mm_unpacklo_epi16(halves01, zero)), ConvertHalfPixel(_mm_unpackhi_epi16(halves01, zero)));
+			const __m128i pixels23 = _mm_packs_epi32(ConvertHalfPixel(_mm_unpacklo_epi16(halves23, zero)), ConvertHalfPixel(_mm_unpackhi_epi16(halves23, zero)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pDestination + pixel), _mm_packus_epi16(pixels01, pixels23));
+		}
+
+		for (; pixel < count; ++pixel)
+		{
+			pDestination[pixel] = PackBGRA8(Load(firstIndex + pixel));
+		}
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include "ColorRGB.h"
+#include "PixelLayout.h"
+#include "ShadingLanes.h"
+
+namespace dae
+{
+	//BGRA8 is the byte order of SDL_PIXELFORMAT_ARGB8888 surfaces, RGBA16F keeps unclamped half floats until the resolve
+	enum class ColorFormat
+	{
+		BGRA8,
+		RGBA16F
+	};
+
+	//Channels are clamped to [0, 1] and truncated, alpha is opaque
+	inline uint32_t PackBGRA8(const ColorRGB& color)
+	{
+		const uint32_t r = uint32_t(std::clamp(color.r, 0.f, 1.f) * 255.f);
+		const uint32_t g = uint32_t(std::clamp(color.g, 0.f, 1.f) * 255.f);
+		const uint32_t b = uint32_t(std::clamp(color.b, 0.f, 1.f) * 255.f);
+		return 0xFF000000u | (r << 16) | (g << 8) | b;
+	}
+
+	//All shading lanes at once, lane for lane the same as the scalar version
+	inline __m128i PackBGRA8(const ColorLanes& color)
+	{
+		const __m128 scale = _mm_set1_ps(255.f);
+		const __m128i r = _mm_cvttps_epi32(_mm_mul_ps(Clamp01(color.r).value, scale));
+		const __m128i g = _mm_cvttps_epi32(_mm_mul_ps(Clamp01(color.g).value, scale));
+		const __m128i b = _mm_cvttps_epi32(_mm_mul_ps(Clamp01(color.b).value, scale));
+		return _mm_or_si128(_mm_or_si128(_mm_set1_epi32(int(0xFF000000u)), _mm_slli_epi32(r, 16)), _mm_or_si128(_mm_slli_epi32(g, 8), b));
+	}
+
+	inline ColorRGB UnpackBGRA8(uint32_t pixel)
+	{
+		return { float((pixel >> 16) & 0xFF) / 255.f, float((pixel >> 8) & 0xFF) / 255.f, float(pixel & 0xFF) / 255.f };
+	}
+
+	//Rebiasing the exponent with a multiply handles half denormals for free, magnitudes beyond the half range saturate
+	inline uint16_t FloatToHalf(float value)
+	{
+		constexpr float rebias{ 1.92592994e-34f }; //2^-112
+		const uint32_t sign = (std::bit_cast<uint32_t>(value) >> 16) & 0x8000u;
+		const uint32_t magnitude = std::bit_cast<uint32_t>(std::min(std::abs(value), 65504.f) * rebias);
+		return uint16_t(sign | ((magnitude + 0x1000u) >> 13));
+	}
+
+	inline float HalfToFloat(uint16_t value)
+	{
+		constexpr float rebias{ 5.19229686e33f }; //2^112
+		return std::bit_cast<float>((uint32_t(value & 0x8000u) << 16) | (uint32_t(value & 0x7FFFu) << 13)) * rebias;
+	}
+
+	//Rewrites BGRA8 pixels into another 32-bit layout with 8-bit channels at the given shifts, alphaMask gets OR-ed in
+	void ConvertBGRA8(const uint32_t* pSource, uint32_t* pDestination, int count, int redShift, int greenShift, int blueShift, uint32_t alphaMask);
+
+	//Color target of the software rasterizer, written by the pixel shading without any format lookups.
+	//Pixels are addressed through the layout, the resolve turns them back into linear rows.
+	class ColorBuffer final
+	{
+	public:
+		//A linear BGRA8 buffer renders straight into pExternalPixels when given (a surface with the same layout), anything else owns its pixels
+		ColorBuffer(const PixelLayout& layout, ColorFormat format, uint32_t* pExternalPixels = nullptr, bool isHugePageRequested = false);
+		~ColorBuffer() = default;
+
+		ColorBuffer(const ColorBuffer& other) = delete;
+		ColorBuffer& operator=(const ColorBuffer& rhs) = delete;
+		ColorBuffer(ColorBuffer&& other) = delete;
+		ColorBuffer& operator=(ColorBuffer&& rhs) = delete;
+
+		ColorFormat GetFormat() const { return m_Format; }
+		const PixelLayout& GetLayout() const { return m_Layout; }
+
+		void Store(int pixelIndex, const ColorRGB& color)
+		{
+			if (m_Format == ColorFormat::BGRA8)
+			{
+				m_pPixelsBGRA8[pixelIndex] = PackBGRA8(color);
+			}
+			else
+			{
+				uint16_t* pPixel = &m_pPixelsRGBA16F[size_t(pixelIndex) * 4];
+				pPixel[0] = FloatToHalf(color.r);
+				pPixel[1] = FloatToHalf(color.g);
+				pPixel[2] = FloatToHalf(color.b);
+				pPixel[3] = HALF_ONE;
+			}
+		}
+
+		//Stores the shading lanes set in laneBits to their pixel indices, BGRA8 packs all lanes in one pass first
+		void Store(const int* pPixelIndices, int laneBits, const ColorLanes& color)
+		{
+			alignas(16) float channels[3][SHADING_LANES];
+			alignas(16) uint32_t pixels[SHADING_LANES];
+			if (m_Format == ColorFormat::BGRA8)
+			{
+				_mm_store_si128(reinterpret_cast<__m128i*>(pixels), PackBGRA8(color));
+			}
+			else
+			{
+				color.r.Store(channels[0]);
+				color.g.Store(channels[1]);
+				color.b.Store(channels[2]);
+			}
+
+			while (laneBits != 0)
+			{
+				const int lane = std::countr_zero(unsigned(laneBits));
+				if (m_Format == ColorFormat::BGRA8) m_pPixelsBGRA8[pPixelIndices[lane]] = pixels[lane];
+				else Store(pPixelIndices[lane], ColorRGB{ channels[0][lane], channels[1][lane], channels[2][lane] });
+				laneBits &= laneBits - 1;
+			}
+		}
+
+		ColorRGB Load(int pixelIndex) const
+		{
+			if (m_Format == ColorFormat::BGRA8) return UnpackBGRA8(m_pPixelsBGRA8[pixelIndex]);
+
+			const uint16_t* pPixel = &m_pPixelsRGBA16F[size_t(pixelIndex) * 4];
+			return { HalfToFloat(pPixel[0]), HalfToFloat(pPixel[1]), HalfToFloat(pPixel[2]) };
+		}
+
+		//Fills the layout indices [firstIndex, lastIndex)
+		void Fill(int firstIndex, int lastIndex, const ColorRGB& color);
+
+		//True when the pixels aren't already linear BGRA8 in pDestination
+		bool IsResolveNeeded(const uint32_t* pDestination) const { return m_Format != ColorFormat::BGRA8 || m_pPixelsBGRA8 != pDestination; }
+		//Clamps and converts part of one row to BGRA8 in one vectorized pass.
+		//[firstPixel, lastPixel) are linear (row-major) pixel indices, both into the screen and into pDestination.
+		void Resolve(int firstPixel, int lastPixel, uint32_t* pDestination) const;
+
+	private:
+		static constexpr uint16_t HALF_ONE{ 0x3C00 };
+
+		PixelLayout m_Layout{};
+		ColorFormat m_Format{};
+
+		std::unique_ptr<PixelStorage> m_pOwnedPixels{};
+		uint32_t* m_pPixelsBGRA8{};
+		uint16_t* m_pPixelsRGBA16F{};
+
+		//Converts count consecutive layout indices from firstIndex on
+		void ResolveRun(int firstIndex, int count, uint32_t* pDestination) const;
+	};
+}
@@ -41,6 +41,13 @@ namespace dae
 		Combined
 	};
 
+	//Software shading math, Fast trades the error bounds documented in FastMath.h for speed
+	enum class ShadingPrecision
+	{
+		Exact,
+		Fast
+	};
+
 	enum FilteringTechnique
 	{
 		Point,
@@ -68,6 +75,5 @@ namespace dae
 		std::vector<uint32_t> indices{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
 
-		std::vector<Vertex_Out> vertices_out{};
 		Matrix worldMatrix{};	};
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "DepthBuffer.h"
+
+namespace dae
+{
+	namespace
+	{
+		//Widens a vertex depth range so it also holds every per-pixel depth, which is rounded on its way through 1 / z
+		constexpr float DEPTH_RANGE_MARGIN{ 1e-5f };
+
+		template<typename T>
+		float CalculateMaxValue(const T* pValues, const PixelLayout& layout, const TileRect& rect)
+		{
+			T maxValue{};
+			layout.ForEachRowRun(rect.minX, rect.minY, rect.maxX, rect.maxY, [&](int firstIndex, int lastIndex)
+			{
+				maxValue = std::max(maxValue, *std::max_element(pValues + firstIndex, pValues + lastIndex));
+			});
+			return float(maxValue);
+		}
+	}
+
+	DepthBuffer::DepthBuffer(const PixelLayout& layout, DepthFormat format, bool isReversedZ, bool isPlaneCompressed, bool isHugePageRequested) :
+		m_Layout{ layout },
+		m_Format{ format },
+		m_IsReversedZ{ isReversedZ },
+		m_IsPlaneCompressed{ isPlaneCompressed }
+	{
+		const size_t bytesPerPixel = format == DepthFormat::Unorm16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		m_pStorage = std::make_unique<PixelStorage>(size_t(layout.GetPixelCount()) * bytesPerPixel, isHugePageRequested);
+
+		if (isPlaneCompressed)
+		{
+			m_BlocksX = (layout.GetWidth() + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+			const int blocksY = (layout.GetHeight() + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+			m_BlockStates.assign(size_t(m_BlocksX) * blocksY, BlockState::Cleared);
+			m_BlockPlanes.resize(m_BlockStates.size());
+		}
+	}
+
+	float DepthBuffer::GetClearKey() const
+	{
+		switch (m_Format)
+		{
+		case DepthFormat::Unorm24:
+			return UNORM24_MAX;
+		case DepthFormat::Unorm16:
+			return UNORM16_MAX;
+		default:
+			// Not a depth at all, so even depth 1 (or 0 reversed) still passes against it
+			return std::numeric_limits<float>::max();
+		}
+	}
+
+	void DepthBuffer::ClearRect(const TileRect& rect)
+	{
+		if (m_IsPlaneCompressed)
+		{
+			for (int blockY = rect.minY / PIXEL_BLOCK_SIZE; blockY * PIXEL_BLOCK_SIZE < rect.maxY; ++blockY)
+			{
+				for (int blockX = rect.minX / PIXEL_BLOCK_SIZE; blockX * PIXEL_BLOCK_SIZE < rect.maxX; ++blockX)
+				{
+					m_BlockStates[blockX + blockY * m_BlocksX] = BlockState::Cleared;
+				}
+			}
+			return;
+		}
+
+		const float clearKey = GetClearKey();
+		m_Layout.ForEachRun(rect.minX, rect.minY, rect.maxX, rect.maxY, [&](int firstIndex, int lastIndex)
+		{
+			switch (m_Format)
+			{
+			case DepthFormat::Float32:
+				std::fill(static_cast<float*>(GetData()) + firstIndex, static_cast<float*>(GetData()) + lastIndex, clearKey);
+				break;
+			case DepthFormat::Unorm24:
+				std::fill(static_cast<uint32_t*>(GetData()) + firstIndex, static_cast<uint32_t*>(GetData()) + lastIndex, uint32_t(clearKey));
+				break;
+			case DepthFormat::Unorm16:
+				std::fill(static_cast<uint16_t*>(GetData()) + firstIndex, static_cast<uint16_t*>(GetData()) + lastIndex, uint16_t(clearKey));
+				break;
+			}
+		});
+	}
+
+	float DepthBuffer::CalculateBlockMaxKey(int blockX, int blockY) const
+	{
+		if (!IsBlockExpanded(blockX, blockY))
+		{
+			if (m_BlockStates[blockX + blockY * m_BlocksX] == BlockState::Cleared) return GetClearKey();
+
+			const DepthPlane& plane = m_BlockPlanes[blockX + blockY * m_BlocksX];
+			return m_IsReversedZ ? ToKey(plane.minDepth * (1.f - DEPTH_RANGE_MARGIN)) : ToKey(plane.maxDepth * (1.f + DEPTH_RANGE_MARGIN));
+		}
+
+		const TileRect rect = GetBlockRect(blockX, blockY);
+		switch (m_Format)
+		{
+		case DepthFormat::Unorm24:
+			return CalculateMaxValue(static_cast<const uint32_t*>(GetData()), m_Layout, rect);
+		case DepthFormat::Unorm16:
+			return CalculateMaxValue(static_cast<const uint16_t*>(GetData()), m_Layout, rect);
+		default:
+			// Keys may be negative with reversed-Z
+			float maxKey = -std::numeric_limits<float>::max();
+			m_Layout.ForEachRowRun(rect.minX, rect.minY, rect.maxX, rect.maxY, [&](int firstIndex, int lastIndex)
+			{
+				const float* pKeys = static_cast<const float*>(GetData());
+				maxKey = std::max(maxKey, *std::max_element(pKeys + firstIndex, pKeys + lastIndex));
+			});
+			return maxKey;
+		}
+	}
+
+	void DepthBuffer::ExpandBlock(int blockX, int blockY)
+	{
+		if (IsBlockExpanded(blockX, blockY)) return;
+
+		const int block = blockX + blockY * m_BlocksX;
+		const TileRect rect = GetBlockRect(blockX, blockY);
+		if (m_BlockStates[block] == BlockState::Cleared)
+		{
+			m_BlockStates[block] = BlockState::Expanded;
+
+			const float clearKey = GetClearKey();
+			m_Layout.ForEachRowRun(rect.minX, rect.minY, rect.maxX, rect.maxY, [&](int firstIndex, int lastIndex)
+			{
+				for (int pixelIndex = firstIndex; pixelIndex < lastIndex; ++pixelIndex)
+				{
+					StoreKey(pixelIndex, clearKey);
+				}
+			});
+			return;
+		}
+
+		// Same arithmetic as the raster kernels, so the pixels come out exactly as if they had been written right away
+		m_BlockStates[block] = BlockState::Expanded;
+		const DepthPlane& plane = m_BlockPlanes[block];
+		for (int py = rect.minY; py < rect.maxY; ++py)
+		{
+			const float relativeY = (float(py) + 0.5f) - plane.weightOriginY;
+			const float rowWeight0 = plane.weightB[0] * relativeY;
+			const float rowWeight1 = plane.weightB[1] * relativeY;
+
+			for (int px = rect.minX; px < rect.maxX; ++px)
+			{
+				const float relativeX = (float(px) + 0.5f) - plane.weightOriginX;
+				const float weight0 = plane.weightA[0] * relativeX + rowWeight0;
+				const float weight1 = plane.weightA[1] * relativeX + rowWeight1;
+				const float weight2 = 1.f - weight0 - weight1;
+
+				StoreKey(m_Layout.GetIndex(px, py), ToKey(1.f / (weight0 * plane.invZ[0] + weight1 * plane.invZ[1] + weight2 * plane.invZ[2])));
+			}
+		}
+	}
+
+	bool DepthBuffer::IsInFrontOfBlock(int blockX, int blockY, float minDepth, float maxDepth) const
+	{
+		// Every pixel has to pass the depth range test of the kernels as well
+		minDepth *= 1.f - DEPTH_RANGE_MARGIN;
+		maxDepth *= 1.f + DEPTH_RANGE_MARGIN;
+		if (minDepth < 0.f || maxDepth > 1.f) return false;
+
+		const float farthestKey = m_IsReversedZ ? ToKey(minDepth) : ToKey(maxDepth);
+
+		const int block = blockX + blockY * m_BlocksX;
+		if (m_BlockStates[block] == BlockState::Cleared) return farthestKey < GetClearKey();
+
+		const DepthPlane& plane = m_BlockPlanes[block];
+		const float planeNearestKey = m_IsReversedZ ? ToKey(plane.maxDepth * (1.f + DEPTH_RANGE_MARGIN)) : ToKey(plane.minDepth * (1.f - DEPTH_RANGE_MARGIN));
+		return farthestKey < planeNearestKey;
+	}
+
+	void DepthBuffer::SetBlockPlane(int blockX, int blockY, const TriangleSetup& triangle)
+	{
+		const int block = blockX + blockY * m_BlocksX;
+		m_BlockStates[block] = BlockState::Plane;
+
+		DepthPlane& plane = m_BlockPlanes[block];
+		std::copy(triangle.weightA, triangle.weightA + 2, plane.weightA);
+		std::copy(triangle.weightB, triangle.weightB + 2, plane.weightB);
+		plane.weightOriginX = triangle.weightOriginX;
+		plane.weightOriginY = triangle.weightOriginY;
+		std::copy(triangle.invZ, triangle.invZ + 3, plane.invZ);
+		plane.minDepth = triangle.minDepth;
+		plane.maxDepth = triangle.maxDepth;
+	}
+
+	bool DepthBuffer::IsBlockPlaneOf(int blockX, int blockY, const TriangleSetup& triangle) const
+	{
+		const int block = blockX + blockY * m_BlocksX;
+		if (m_BlockStates[block] != BlockState::Plane) return false;
+
+		const DepthPlane& plane = m_BlockPlanes[block];
+		return std::equal(plane.weightA, plane.weightA + 2, triangle.weightA) && std::equal(plane.weightB, plane.weightB + 2, triangle.weightB) &&
+			plane.weightOriginX == triangle.weightOriginX && plane.weightOriginY == triangle.weightOriginY && std::equal(plane.invZ, plane.invZ + 3, triangle.invZ);
+	}
+
+	TileRect DepthBuffer::GetBlockRect(int blockX, int blockY) const
+	{
+		TileRect rect;
+		rect.minX = blockX * PIXEL_BLOCK_SIZE;
+		rect.minY = blockY * PIXEL_BLOCK_SIZE;
+		rect.maxX = std::min(rect.minX + PIXEL_BLOCK_SIZE, m_Layout.GetWidth());
+		rect.maxY = std::min(rect.minY + PIXEL_BLOCK_SIZE, m_Layout.GetHeight());
+		return rect;
+	}
+
+	void DepthBuffer::StoreKey(int pixelIndex, float key)
+	{
+		switch (m_Format)
+		{
+		case DepthFormat::Unorm24:
+			static_cast<uint32_t*>(GetData())[pixelIndex] = uint32_t(key);
+			break;
+		case DepthFormat::Unorm16:
+			static_cast<uint16_t*>(GetData())[pixelIndex] = uint16_t(key);
+			break;
+		default:
+			static_cast<float*>(GetData())[pixelIndex] = key;
+			break;
+		}
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Rasterizer.h"
+
+namespace dae
+{
+	enum class DepthFormat
+	{
+		Float32,
+		Unorm24,	//kept in 32-bit words, same precision everywhere unlike float
+		Unorm16		//half the bandwidth, good enough for small viewports
+	};
+
+	//Depth target of the software rasterizer, addressed through the pixel layout of the color buffer.
+	//The depth test works on keys where smaller is closer: the float depth itself, its negation for reversed-Z, or the unorm value.
+	//Plane compression keeps 8x8 blocks that a single triangle covers as that triangle's depth plane, pixels are only written when
+	//another triangle partially overlaps the block.
+	class DepthBuffer final
+	{
+	public:
+		DepthBuffer(const PixelLayout& layout, DepthFormat format, bool isReversedZ, bool isPlaneCompressed, bool isHugePageRequested = false);
+		~DepthBuffer() = default;
+
+		DepthBuffer(const DepthBuffer& other) = delete;
+		DepthBuffer& operator=(const DepthBuffer& rhs) = delete;
+		DepthBuffer(DepthBuffer&& other) = delete;
+		DepthBuffer& operator=(DepthBuffer&& rhs) = delete;
+
+		const PixelLayout& GetLayout() const { return m_Layout; }
+		DepthFormat GetFormat() const { return m_Format; }
+		bool IsReversedZ() const { return m_IsReversedZ; }
+		bool IsPlaneCompressed() const { return m_IsPlaneCompressed; }
+		void* GetData() const { return m_pStorage->GetData<void>(); }
+
+		//Key every cleared pixel holds, farther than anything that passes the depth range test
+		float GetClearKey() const;
+		//Same conversion the raster kernels do before the depth test
+		float ToKey(float depth) const
+		{
+			if (m_Format == DepthFormat::Float32) return m_IsReversedZ ? -depth : depth;
+
+			// Unclipped depths (a vertex in front of the near plane) would wrap around when quantized
+			const float scale = m_Format == DepthFormat::Unorm24 ? UNORM24_MAX : UNORM16_MAX;
+			return float(uint32_t(std::clamp(m_IsReversedZ ? 1.f - depth : depth, 0.f, 1.f) * scale + 0.5f));
+		}
+		//Smallest key of anything with a depth inside [minDepth, maxDepth]
+		float GetNearestKey(float minDepth, float maxDepth) const { return ToKey(m_IsReversedZ ? maxDepth : minDepth); }
+		//Depth as a regular projection (near 0, far 1) would have produced it
+		float ToForwardDepth(float depth) const { return m_IsReversedZ ? 1.f - depth : depth; }
+
+		//Sets the rect to the clear key, compressed blocks just get marked cleared
+		void ClearRect(const TileRect& rect);
+		//Farthest key inside the rect of one block, conservative for compressed blocks
+		float CalculateBlockMaxKey(int blockX, int blockY) const;
+
+		//Compressed blocks hold no pixels, the raster kernels only ever see expanded ones
+		bool IsBlockExpanded(int blockX, int blockY) const { return !m_IsPlaneCompressed || m_BlockStates[blockX + blockY * m_BlocksX] == BlockState::Expanded; }
+		bool IsBlockCleared(int blockX, int blockY) const { return m_IsPlaneCompressed && m_BlockStates[blockX + blockY * m_BlocksX] == BlockState::Cleared; }
+		//Writes out the pixels of a cleared or plane block
+		void ExpandBlock(int blockX, int blockY);
+		//True when every pixel of a triangle with depths in [minDepth, maxDepth] passes the depth test inside the compressed block
+		bool IsInFrontOfBlock(int blockX, int blockY, float minDepth, float maxDepth) const;
+		//Replaces the block by the depth of a triangle covering all of it
+		void SetBlockPlane(int blockX, int blockY, const TriangleSetup& triangle);
+		//True when the block holds the plane of this very triangle
+		bool IsBlockPlaneOf(int blockX, int blockY, const TriangleSetup& triangle) const;
+
+		static constexpr float UNORM24_MAX{ 16777215.f };
+		static constexpr float UNORM16_MAX{ 65535.f };
+
+	private:
+		enum class BlockState : uint8_t
+		{
+			Expanded,
+			Cleared,
+			Plane
+		};
+
+		//Just what the kernels evaluate depth from, so an expanded plane matches the pixels they'd have written
+		struct DepthPlane
+		{
+			float weightA[2]{};
+			float weightB[2]{};
+			float weightOriginX{};
+			float weightOriginY{};
+			float invZ[3]{};
+			float minDepth{};
+			float maxDepth{};
+		};
+
+		PixelLayout m_Layout{};
+		DepthFormat m_Format{};
+		bool m_IsReversedZ{};
+		bool m_IsPlaneCompressed{};
+		std::unique_ptr<PixelStorage> m_pStorage{};
+
+		int m_BlocksX{};
+		std::vector<BlockState> m_BlockStates{};
+		std::vector<DepthPlane> m_BlockPlanes{};
+
+		TileRect GetBlockRect(int blockX, int blockY) const;
+		void StoreKey(int pixelIndex, float key);
+	};
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <immintrin.h>
+#include "DataTypes.h"
+#include "ShadingLanes.h"
+
+//Approximate tier of the shading math. Bounds were measured over every float in the stated ranges
+namespace dae
+{
+	//1 / x from the hardware estimate plus one Newton-Raphson step: relative error below 2.5e-7 for 2^-126 < |x| < 2^126
+	inline FloatLanes FastReciprocal(const FloatLanes& x)
+	{
+		const FloatLanes estimate = _mm_rcp_ps(x.value);
+		return estimate * (2.f - x * estimate);
+	}
+
+	//1 / sqrt(x) the same way: relative error below 3e-7 for normal x > 0
+	inline FloatLanes FastReciprocalSqrt(const FloatLanes& x)
+	{
+		const FloatLanes estimate = _mm_rsqrt_ps(x.value);
+		return 0.5f * estimate * (3.f - x * estimate * estimate);
+	}
+
+	//Length of the result is 1 within 3e-7
+	inline Vector3Lanes FastNormalized(const Vector3Lanes& v)
+	{
+		return v * FastReciprocalSqrt(Vector3Lanes::Dot(v, v));
+	}
+
+	//Exponent bits plus a degree 4 polynomial of the mantissa in [1, 2): absolute error below 2.1e-5 for x > 0, denormals count as FLT_MIN
+	inline FloatLanes FastLog2(const FloatLanes& x)
+	{
+		const __m128i bits = _mm_castps_si128(_mm_max_ps(x.value, _mm_set1_ps(1.17549435e-38f)));
+		const FloatLanes exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+		const FloatLanes mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+
+		// log2(m) = (m - 1) * p(m), exact at m = 1
+		FloatLanes polynomial = 0.0452685827f;
+		polynomial = polynomial * mantissa - 0.37459157f;
+		polynomial = polynomial * mantissa + 1.26740938f;
+		polynomial = polynomial * mantissa - 2.30098381f;
+		polynomial = polynomial * mantissa + 2.80477733f;
+		return polynomial * (mantissa - 1.f) + exponent;
+	}
+
+	//Integer part into the exponent bits, degree 4 polynomial for the fraction: relative error below 2.8e-6, x is clamped to [-126, 128)
+	inline FloatLanes FastExp2(const FloatLanes& x)
+	{
+		const __m128 clamped = _mm_min_ps(_mm_max_ps(x.value, _mm_set1_ps(-126.f)), _mm_set1_ps(127.99999f));
+
+		// Floor from truncation, one down for negative fractions
+		__m128i integer = _mm_cvttps_epi32(clamped);
+		integer = _mm_add_epi32(integer, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(integer), clamped)));
+		const FloatLanes fraction = FloatLanes{ clamped } - FloatLanes{ _mm_cvtepi32_ps(integer) };
+
+		FloatLanes polynomial = 0.0135206033f;
+		polynomial = polynomial * fraction + 0.0520374287f;
+		polynomial = polynomial * fraction + 0.241427493f;
+		polynomial = polynomial * fraction + 0.693006621f;
+		polynomial = polynomial * fraction + 1.00000252f;
+		return polynomial * FloatLanes{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(integer, _mm_set1_epi32(127)), 23)) };
+	}
+
+	//base ^ exponent for base >= 0: relative error below 2.8e-6 + 1.5e-5 * |exponent|, so under 3e-4 for the glossiness-scaled
+	//Phong exponents up to 25. A base of exactly 0 gives 0 (1 for exponent 0), results under 2^-126 come out as about 2^-126
+	inline FloatLanes FastPow(const FloatLanes& base, const FloatLanes& exponent)
+	{
+		const FloatLanes power = FastExp2(exponent * FastLog2(base));
+		return Select(base > 0.f, power, Select(exponent == 0.f, 1.f, 0.f));
+	}
+
+	//Shading math of one precision tier, picked at compile time like the other shading switches
+	template<ShadingPrecision precision>
+	struct ShadingMath
+	{
+		static constexpr bool IS_FAST{ precision == ShadingPrecision::Fast };
+
+		static FloatLanes Reciprocal(const FloatLanes& x)
+		{
+			if constexpr (IS_FAST) return FastReciprocal(x);
+			else return 1.f / x;
+		}
+
+		static Vector3Lanes Normalized(const Vector3Lanes& v)
+		{
+			if constexpr (IS_FAST) return FastNormalized(v);
+			else return v.Normalized();
+		}
+
+		static FloatLanes Pow(const FloatLanes& base, const FloatLanes& exponent)
+		{
+			if constexpr (IS_FAST) return FastPow(base, exponent);
+			else return dae::Pow(base, exponent);
+		}
+	};
+}
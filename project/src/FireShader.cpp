@@ -0,0 +1,7 @@
+#include "pch.h"
+#include "FireShader.h"
+
+FireShader::FireShader(FireEffect& effect)
+	: m_pDiffuse(effect.GetDiffuseTexture())
+{
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "SoftwareShader.h"
+#include "FireEffect.h"
+
+//CPU counterpart of FireEffect (Fire3D.fx): unlit diffuse, alpha blended over the target without writing depth.
+//Like the effect it has no lighting, so it looks the same in every shading mode
+class FireShader final
+{
+public:
+	static constexpr bool IS_TRANSPARENT{ true };
+
+	//The texture is owned by the effect, which has to outlive the shader
+	explicit FireShader(FireEffect& effect);
+
+	static uint32_t GetVaryings(ShadingMode /*shadingMode*/, bool /*isNormalMap*/) { return AttributeUV; }
+
+	bool HasNormalMap() const { return false; }
+
+	void ShadeVertices(const VertexStreams& vertices, int first, int last, const VertexConstants& constants, VertexStreams_Out& out) const
+	{
+		constants.worldViewProjection.TransformPoints(vertices.position, out.position, first, last);
+		out.uv.Assign(vertices.uv, first, last);
+	}
+
+	template<ShadingMode shadingMode, bool isNormalMap, ShadingPrecision precision>
+	ColorLanes ShadePixels(const VaryingLanes& v, const ColorLanes& target) const
+	{
+		if (m_pDiffuse == nullptr) return {};
+
+		FloatLanes alphaValue;
+		const ColorLanes currentColor = m_pDiffuse->SampleLanes(v.uv, alphaValue);
+		return (currentColor * alphaValue) + (target * (1.0f - alphaValue));
+	}
+
+private:
+	const Texture* m_pDiffuse{};
+};
+
+static_assert(SoftwareShader<FireShader>);
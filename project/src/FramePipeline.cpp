@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "FramePipeline.h"
+
+namespace dae
+{
+	FramePipeline::FramePipeline(int depth, RenderFunction renderFunction, PresentFunction presentFunction) :
+		m_Depth{ std::max(depth, 1) },
+		m_RenderFunction{ std::move(renderFunction) },
+		m_PresentFunction{ std::move(presentFunction) }
+	{
+		if (m_Depth > 1)
+		{
+			m_RenderThread = std::thread{ &FramePipeline::RenderLoop, this };
+		}
+	}
+
+	FramePipeline::~FramePipeline()
+	{
+		if (!m_RenderThread.joinable()) return;
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_Condition.notify_all();
+		m_RenderThread.join();
+	}
+
+	int FramePipeline::AcquireSlot()
+	{
+		// Frames finish in order, so with fewer than depth frames in flight the next slot is free
+		PresentUntil([this]() { return m_NumInFlight < m_Depth; });
+		return m_NextSlot;
+	}
+
+	void FramePipeline::Submit(int slot)
+	{
+		m_NextSlot = (slot + 1) % m_Depth;
+
+		if (!m_RenderThread.joinable())
+		{
+			m_RenderFunction(slot);
+			m_PresentFunction(slot);
+			return;
+		}
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			++m_NumInFlight;
+			m_PendingSlots.push_back(slot);
+		}
+		m_Condition.notify_all();
+
+		PresentRendered();
+	}
+
+	void FramePipeline::Flush()
+	{
+		PresentUntil([this]() { return m_NumInFlight == 0; });
+	}
+
+	void FramePipeline::RenderLoop()
+	{
+		while (true)
+		{
+			int slot;
+			{
+				// Frames not rendered yet are dropped when stopping, the owner flushes before
+				std::unique_lock lock{ m_Mutex };
+				m_Condition.wait(lock, [this]() { return m_IsStopping || (!m_PendingSlots.empty() && m_NumUnpresented == 0); });
+				if (m_IsStopping) return;
+
+				slot = m_PendingSlots.front();
+				m_PendingSlots.pop_front();
+			}
+
+			m_RenderFunction(slot);
+
+			{
+				std::lock_guard lock{ m_Mutex };
+				m_RenderedSlots.push_back(slot);
+				++m_NumUnpresented;
+			}
+			m_Condition.notify_all();
+		}
+	}
+
+	void FramePipeline::PresentRendered()
+	{
+		while (true)
+		{
+			int slot;
+			{
+				std::lock_guard lock{ m_Mutex };
+				if (m_RenderedSlots.empty()) return;
+
+				slot = m_RenderedSlots.front();
+				m_RenderedSlots.pop_front();
+			}
+
+			m_PresentFunction(slot);
+
+			{
+				std::lock_guard lock{ m_Mutex };
+				--m_NumUnpresented;
+				--m_NumInFlight;
+			}
+			m_Condition.notify_all();
+		}
+	}
+
+	template<typename Predicate>
+	void FramePipeline::PresentUntil(Predicate isDone)
+	{
+		while (true)
+		{
+			PresentRendered();
+
+			std::unique_lock lock{ m_Mutex };
+			if (isDone()) return;
+			m_Condition.wait(lock, [&]() { return isDone() || !m_RenderedSlots.empty(); });
+		}
+	}
+}
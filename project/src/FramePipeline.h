@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace dae
+{
+	//Overlaps the update of the next frames with the render stage of earlier ones.
+	//Frames render in submission order on a dedicated thread, a frame owns one of the depth slots until it's presented.
+	//Presenting always happens on the submitting thread (the one owning the window), while it acquires, submits or flushes.
+	//Depth 1 keeps everything serial, rendering and presenting on the submitting thread.
+	class FramePipeline final
+	{
+	public:
+		using RenderFunction = std::function<void(int slot)>;
+		using PresentFunction = std::function<void(int slot)>;
+
+		FramePipeline(int depth, RenderFunction renderFunction, PresentFunction presentFunction);
+		~FramePipeline();
+
+		FramePipeline(const FramePipeline& other) = delete;
+		FramePipeline& operator=(const FramePipeline& rhs) = delete;
+		FramePipeline(FramePipeline&& other) = delete;
+		FramePipeline& operator=(FramePipeline&& rhs) = delete;
+
+		int GetDepth() const { return m_Depth; }
+
+		//Blocks until the frame that last used the next slot is presented, the slot can then be filled for a new frame
+		int AcquireSlot();
+		//Hands the frame of an acquired slot to the render stage, presents the frames rendered meanwhile
+		void Submit(int slot);
+		//Blocks until every submitted frame is presented
+		void Flush();
+
+	private:
+		int m_Depth{};
+		RenderFunction m_RenderFunction{};
+		PresentFunction m_PresentFunction{};
+
+		int m_NextSlot{};
+		int m_NumInFlight{};
+		std::deque<int> m_PendingSlots{};
+		//Rendered frames waiting for their present, the render stage shares its targets so it waits for them
+		std::deque<int> m_RenderedSlots{};
+		int m_NumUnpresented{};
+		bool m_IsStopping{ false };
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		std::thread m_RenderThread{};
+
+		void RenderLoop();
+		//Presents every rendered frame on the calling thread
+		void PresentRendered();
+		//Presents rendered frames until isDone holds (checked under the lock)
+		template<typename Predicate>
+		void PresentUntil(Predicate isDone);
+	};
+}
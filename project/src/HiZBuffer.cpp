@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "HiZBuffer.h"
+#include "DepthBuffer.h"
+
+namespace dae
+{
+	HiZBuffer::HiZBuffer(int width, int height) :
+		m_Width{ width },
+		m_Height{ height },
+		m_BlocksX{ (width + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE },
+		m_BlocksY{ (height + HIZ_BLOCK_SIZE - 1) / HIZ_BLOCK_SIZE },
+		m_TilesX{ (width + TILE_SIZE - 1) / TILE_SIZE },
+		m_TilesY{ (height + TILE_SIZE - 1) / TILE_SIZE }
+	{
+		m_BlockMaxDepth.resize(size_t(m_BlocksX) * m_BlocksY);
+		m_TileMaxDepth.resize(size_t(m_TilesX) * m_TilesY);
+	}
+
+	void HiZBuffer::Clear(float key)
+	{
+		std::fill(m_BlockMaxDepth.begin(), m_BlockMaxDepth.end(), key);
+		std::fill(m_TileMaxDepth.begin(), m_TileMaxDepth.end(), key);
+	}
+
+	void HiZBuffer::UpdateBlock(int blockX, int blockY, const DepthBuffer& depthBuffer)
+	{
+		m_BlockMaxDepth[blockX + blockY * m_BlocksX] = depthBuffer.CalculateBlockMaxKey(blockX, blockY);
+	}
+
+	void HiZBuffer::UpdateTile(const TileRect& tile)
+	{
+		const int minBlockX = tile.minX / HIZ_BLOCK_SIZE;
+		const int minBlockY = tile.minY / HIZ_BLOCK_SIZE;
+		const int maxBlockX = (tile.maxX - 1) / HIZ_BLOCK_SIZE;
+		const int maxBlockY = (tile.maxY - 1) / HIZ_BLOCK_SIZE;
+
+		// Reversed-Z float keys are negative
+		float maxDepth = std::numeric_limits<float>::lowest();
+		for (int blockY = minBlockY; blockY <= maxBlockY; ++blockY)
+		{
+			for (int blockX = minBlockX; blockX <= maxBlockX; ++blockX)
+			{
+				maxDepth = std::max(maxDepth, GetBlockMaxDepth(blockX, blockY));
+			}
+		}
+		m_TileMaxDepth[tile.minX / TILE_SIZE + (tile.minY / TILE_SIZE) * m_TilesX] = maxDepth;
+	}
+
+	bool HiZBuffer::IsOccluded(const TileRect& rect, float nearestKey) const
+	{
+		const int minX = std::max(rect.minX, 0);
+		const int minY = std::max(rect.minY, 0);
+		const int maxX = std::min(rect.maxX, m_Width);
+		const int maxY = std::min(rect.maxY, m_Height);
+
+		// Nothing on screen, nothing to draw
+		if (minX >= maxX || minY >= maxY) return true;
+
+		for (int tileY = minY / TILE_SIZE; tileY <= (maxY - 1) / TILE_SIZE; ++tileY)
+		{
+			for (int tileX = minX / TILE_SIZE; tileX <= (maxX - 1) / TILE_SIZE; ++tileX)
+			{
+				if (nearestKey >= m_TileMaxDepth[tileX + tileY * m_TilesX]) continue;
+
+				// Tile is not conclusive, check the blocks of the rect inside it
+				const int minBlockX = std::max(minX, tileX * TILE_SIZE) / HIZ_BLOCK_SIZE;
+				const int minBlockY = std::max(minY, tileY * TILE_SIZE) / HIZ_BLOCK_SIZE;
+				const int maxBlockX = (std::min(maxX, (tileX + 1) * TILE_SIZE) - 1) / HIZ_BLOCK_SIZE;
+				const int maxBlockY = (std::min(maxY, (tileY + 1) * TILE_SIZE) - 1) / HIZ_BLOCK_SIZE;
+				for (int blockY = minBlockY; blockY <= maxBlockY; ++blockY)
+				{
+					for (int blockX = minBlockX; blockX <= maxBlockX; ++blockX)
+					{
+						if (nearestKey < GetBlockMaxDepth(blockX, blockY)) return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+}
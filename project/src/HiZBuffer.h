@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "Rasterizer.h"
+
+namespace dae
+{
+	//Depth buffer pixels summarized per 8x8 block, blocks nest inside the rasterizer tiles
+	constexpr int HIZ_BLOCK_SIZE{ 8 };
+	static_assert(HIZ_BLOCK_SIZE == PIXEL_BLOCK_SIZE, "Raster kernels scan one HiZ block at a time, its rows have to be consecutive in a blocked layout");
+
+	//Conservative farthest depth key (see DepthBuffer) per block and per tile, kept next to the depth buffer.
+	//Anything whose nearest key is at or behind these values can be rejected without touching pixels.
+	class HiZBuffer final
+	{
+	public:
+		HiZBuffer(int width, int height);
+		~HiZBuffer() = default;
+
+		HiZBuffer(const HiZBuffer& other) = delete;
+		HiZBuffer& operator=(const HiZBuffer& rhs) = delete;
+		HiZBuffer(HiZBuffer&& other) = delete;
+		HiZBuffer& operator=(HiZBuffer&& rhs) = delete;
+
+		//Matches a depth buffer clear
+		void Clear(float key);
+
+		//Recomputes a block from the depth buffer after depth was written into it
+		void UpdateBlock(int blockX, int blockY, const DepthBuffer& depthBuffer);
+		//Recomputes a tile from its blocks, only the worker owning the tile may call this
+		void UpdateTile(const TileRect& tile);
+
+		float GetBlockMaxDepth(int blockX, int blockY) const { return m_BlockMaxDepth[blockX + blockY * m_BlocksX]; }
+		float GetTileMaxDepth(const TileRect& tile) const { return m_TileMaxDepth[tile.minX / TILE_SIZE + (tile.minY / TILE_SIZE) * m_TilesX]; }
+
+		//True when something at nearestKey can't be visible anywhere inside the screen rect
+		bool IsOccluded(const TileRect& rect, float nearestKey) const;
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_BlocksX{};
+		int m_BlocksY{};
+		int m_TilesX{};
+		int m_TilesY{};
+
+		std::vector<float> m_BlockMaxDepth{};
+		std::vector<float> m_TileMaxDepth{};
+	};
+}
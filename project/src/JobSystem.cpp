@@ -0,0 +1,240 @@
+#include "pch.h"
+#include "JobSystem.h"
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		//Queue owned by the current thread, the thread calling Run uses the first one
+		thread_local int t_QueueIndex{ 0 };
+
+		void PinToCore(std::thread& thread, int core)
+		{
+#if defined(_WIN32)
+			SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+			cpu_set_t cpuSet;
+			CPU_ZERO(&cpuSet);
+			CPU_SET(core % CPU_SETSIZE, &cpuSet);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet);
+#else
+			(void)thread;
+			(void)core;
+#endif
+		}
+	}
+
+	JobId JobGraph::AddJob(JobFunction function, const std::vector<JobId>& dependencies)
+	{
+		const JobId id = JobId(m_Jobs.size());
+		Job& job = m_Jobs.emplace_back();
+		job.function = std::move(function);
+
+		for (JobId dependency : dependencies)
+		{
+			if (dependency == INVALID_JOB) continue;
+
+			m_Jobs[dependency].successors.push_back(id);
+			++job.numDependencies;
+		}
+		return id;
+	}
+
+	JobId JobGraph::AddParallelFor(int count, int grainSize, RangeFunction function, const std::vector<JobId>& dependencies)
+	{
+		//Every range shares the same function object
+		const auto pFunction = std::make_shared<RangeFunction>(std::move(function));
+		grainSize = std::max(grainSize, 1);
+
+		std::vector<JobId> ranges;
+		ranges.reserve((count + grainSize - 1) / grainSize);
+		for (int first = 0; first < count; first += grainSize)
+		{
+			const int last = std::min(first + grainSize, count);
+			ranges.push_back(AddJob([pFunction, first, last]() { (*pFunction)(first, last); }, dependencies));
+		}
+
+		//Empty join job, so successors only need a single dependency
+		return AddJob({}, ranges.empty() ? dependencies : ranges);
+	}
+
+	void JobGraph::Clear()
+	{
+		m_Jobs.clear();
+	}
+
+	JobSystem::JobSystem(int numThreads, bool isAffinityPinned)
+	{
+		if (numThreads <= 0)
+		{
+			numThreads = std::max(int(std::thread::hardware_concurrency()), 1);
+		}
+
+		m_Queues = std::vector<WorkQueue>(numThreads);
+		m_Workers.reserve(numThreads - 1);
+		for (int queueIndex = 1; queueIndex < numThreads; ++queueIndex)
+		{
+			m_Workers.emplace_back(&JobSystem::WorkerLoop, this, queueIndex);
+			if (isAffinityPinned)
+			{
+				PinToCore(m_Workers.back(), queueIndex);
+			}
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard lock{ m_SleepMutex };
+			m_IsStopping = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void JobSystem::Run(JobGraph& graph)
+	{
+		if (graph.m_Jobs.empty()) return;
+
+		graph.m_NumRemaining = graph.GetJobCount();
+
+		for (JobGraph::Job& job : graph.m_Jobs)
+		{
+			job.numPending = job.numDependencies;
+		}
+		for (JobId job = 0; job < graph.GetJobCount(); ++job)
+		{
+			if (graph.m_Jobs[job].numDependencies == 0)
+			{
+				Push(&graph, job);
+			}
+		}
+
+		// Help out until the whole graph is done, possibly with jobs of other graphs
+		while (graph.m_NumRemaining.load(std::memory_order_acquire) > 0)
+		{
+			QueuedJob job;
+			if (TryGetJob(t_QueueIndex, job))
+			{
+				Execute(job);
+				continue;
+			}
+
+			// Nothing to take, sleep with the workers until something gets queued or the graph's last job finished
+			std::unique_lock lock{ m_SleepMutex };
+			++m_NumSleeping;
+			m_WakeCondition.wait(lock, [this, &graph]() { return m_NumQueued > 0 || graph.m_NumRemaining.load(std::memory_order_acquire) == 0; });
+			--m_NumSleeping;
+		}
+	}
+
+	void JobSystem::WorkerLoop(int queueIndex)
+	{
+		t_QueueIndex = queueIndex;
+
+		while (true)
+		{
+			QueuedJob job;
+			if (TryGetJob(queueIndex, job))
+			{
+				Execute(job);
+				continue;
+			}
+
+			std::unique_lock lock{ m_SleepMutex };
+			++m_NumSleeping;
+			m_WakeCondition.wait(lock, [this]() { return m_IsStopping || m_NumQueued > 0; });
+			--m_NumSleeping;
+
+			if (m_IsStopping) return;
+		}
+	}
+
+	void JobSystem::Push(JobGraph* pGraph, JobId job)
+	{
+		WorkQueue& queue = m_Queues[t_QueueIndex];
+		{
+			std::lock_guard lock{ queue.mutex };
+			queue.jobs.push_back({ pGraph, job });
+			++m_NumQueued;
+		}
+
+		// Only pay for the wake-up when someone is actually asleep
+		if (m_NumSleeping > 0)
+		{
+			{
+				std::lock_guard lock{ m_SleepMutex };
+			}
+			m_WakeCondition.notify_one();
+		}
+	}
+
+	bool JobSystem::TryGetJob(int queueIndex, QueuedJob& job)
+	{
+		if (m_NumQueued == 0) return false;
+
+		// Own queue first, newest job is the one most likely still in cache
+		{
+			WorkQueue& queue = m_Queues[queueIndex];
+			std::lock_guard lock{ queue.mutex };
+			if (!queue.jobs.empty())
+			{
+				job = queue.jobs.back();
+				queue.jobs.pop_back();
+				--m_NumQueued;
+				return true;
+			}
+		}
+
+		// Steal the oldest job of another thread
+		const int numQueues = GetThreadCount();
+		for (int offset = 1; offset < numQueues; ++offset)
+		{
+			WorkQueue& queue = m_Queues[(queueIndex + offset) % numQueues];
+			std::lock_guard lock{ queue.mutex };
+			if (!queue.jobs.empty())
+			{
+				job = queue.jobs.front();
+				queue.jobs.pop_front();
+				--m_NumQueued;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void JobSystem::Execute(const QueuedJob& job)
+	{
+		JobGraph& graph = *job.pGraph;
+		JobGraph::Job& current = graph.m_Jobs[job.job];
+		if (current.function)
+		{
+			current.function();
+		}
+
+		for (JobId successor : current.successors)
+		{
+			if (graph.m_Jobs[successor].numPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				Push(&graph, successor);
+			}
+		}
+
+		// Last touch of the graph, its owner may clear it right after
+		if (graph.m_NumRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			// Wake the thread waiting in Run for this graph
+			{
+				std::lock_guard lock{ m_SleepMutex };
+			}
+			m_WakeCondition.notify_all();
+		}
+	}
+}
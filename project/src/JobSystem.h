@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	using JobId = int;
+	constexpr JobId INVALID_JOB{ -1 };
+
+	//Work of a frame as jobs with dependencies, built on the calling thread and executed by the job system.
+	//Jobs may only be added while the graph isn't running.
+	class JobGraph final
+	{
+	public:
+		using JobFunction = std::function<void()>;
+		using RangeFunction = std::function<void(int first, int last)>;
+
+		JobGraph() = default;
+		~JobGraph() = default;
+
+		JobGraph(const JobGraph& other) = delete;
+		JobGraph& operator=(const JobGraph& rhs) = delete;
+		JobGraph(JobGraph&& other) = delete;
+		JobGraph& operator=(JobGraph&& rhs) = delete;
+
+		//Runs function once every dependency finished, INVALID_JOB dependencies are ignored
+		JobId AddJob(JobFunction function, const std::vector<JobId>& dependencies = {});
+		//Splits [0, count) into ranges of at most grainSize, the returned job finishes after every range did
+		JobId AddParallelFor(int count, int grainSize, RangeFunction function, const std::vector<JobId>& dependencies = {});
+
+		void Clear();
+		int GetJobCount() const { return int(m_Jobs.size()); }
+
+	private:
+		friend class JobSystem;
+
+		struct Job
+		{
+			JobFunction function{};
+			std::vector<JobId> successors{};
+			int numDependencies{};
+			std::atomic<int> numPending{};
+		};
+
+		//Deque keeps jobs in place, the atomics can't move
+		std::deque<Job> m_Jobs{};
+		std::atomic<int> m_NumRemaining{};
+	};
+
+	//Persistent worker threads, each with its own deque of ready jobs.
+	//Workers pop their own newest job first and steal the oldest job of another worker when they run dry.
+	class JobSystem final
+	{
+	public:
+		//numThreads includes the thread calling Run, 0 uses every hardware thread.
+		//Pinned workers are bound to one core each, the calling thread is left alone.
+		explicit JobSystem(int numThreads = 0, bool isAffinityPinned = false);
+		~JobSystem();
+
+		JobSystem(const JobSystem& other) = delete;
+		JobSystem& operator=(const JobSystem& rhs) = delete;
+		JobSystem(JobSystem&& other) = delete;
+		JobSystem& operator=(JobSystem&& rhs) = delete;
+
+		//Blocks until every job of the graph ran, the calling thread executes jobs meanwhile and sleeps when there are none.
+		//Several threads may run their own graphs at once, jobs must not run graphs themselves.
+		void Run(JobGraph& graph);
+
+		int GetThreadCount() const { return int(m_Queues.size()); }
+
+	private:
+		struct QueuedJob
+		{
+			JobGraph* pGraph;
+			JobId job;
+		};
+
+		//Threads outside the pool share the first queue
+		struct WorkQueue
+		{
+			std::mutex mutex{};
+			std::deque<QueuedJob> jobs{};
+		};
+
+		std::vector<WorkQueue> m_Queues{};
+		std::vector<std::thread> m_Workers{};
+
+		std::atomic<int> m_NumQueued{};
+
+		//Idle workers and threads waiting in Run sleep until something gets queued
+		std::mutex m_SleepMutex{};
+		std::condition_variable m_WakeCondition{};
+		std::atomic<int> m_NumSleeping{};
+		bool m_IsStopping{ false };
+
+		void WorkerLoop(int queueIndex);
+		void Push(JobGraph* pGraph, JobId job);
+		bool TryGetJob(int queueIndex, QueuedJob& job);
+		void Execute(const QueuedJob& job);
+	};
+}
@@ -5,7 +5,46 @@
 #include <cassert>
 
 #include "MathHelpers.h"
+#include "SimdLevel.h"
+#include "VertexStreams.h"
 #include <cmath>
+#include <immintrin.h>
+
+namespace
+{
+	//Transforms VERTEX_LANES vertices per iteration and returns how many it did, the rest is left to the scalar loop.
+	//Multiplications and additions happen in the same order as in the single vertex functions, so results match them bit for bit
+	template<int numComponents, bool isPoint>
+	DAE_TARGET_AVX2 int TransformAVX2(const dae::Matrix& matrix, const float* pX, const float* pY, const float* pZ, float* const (&pOut)[numComponents], int count)
+	{
+		__m256 rows[4][numComponents];
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int component = 0; component < numComponents; ++component)
+			{
+				rows[row][component] = _mm256_set1_ps(matrix[row][component]);
+			}
+		}
+
+		int index = 0;
+		for (; index + dae::VERTEX_LANES <= count; index += dae::VERTEX_LANES)
+		{
+			const __m256 x = _mm256_loadu_ps(pX + index);
+			const __m256 y = _mm256_loadu_ps(pY + index);
+			const __m256 z = _mm256_loadu_ps(pZ + index);
+			for (int component = 0; component < numComponents; ++component)
+			{
+				__m256 result = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rows[0][component], x), _mm256_mul_ps(rows[1][component], y)), _mm256_mul_ps(rows[2][component], z));
+				if constexpr (isPoint)
+				{
+					result = _mm256_add_ps(result, rows[3][component]);
+				}
+				_mm256_storeu_ps(pOut[component] + index, result);
+			}
+		}
+		return index;
+	}
+}
 
 namespace dae {
 	Matrix::Matrix(const Vector3& xAxis, const Vector3& yAxis, const Vector3& zAxis, const Vector3& t) :
@@ -72,6 +111,61 @@ namespace dae {
 		};
 	}
 
+	void Matrix::TransformVectors(const Vector3Stream& vectors, Vector3Stream& out, int first, int last) const
+	{
+		int index = first;
+		if (GetSimdLevel() == SimdLevel::AVX2)
+		{
+			float* const pOut[3]{ out.x.data() + first, out.y.data() + first, out.z.data() + first };
+			index += TransformAVX2<3, false>(*this, vectors.x.data() + first, vectors.y.data() + first, vectors.z.data() + first, pOut, last - first);
+		}
+
+		for (; index < last; ++index)
+		{
+			const Vector3 v = TransformVector(vectors.x[index], vectors.y[index], vectors.z[index]);
+			out.x[index] = v.x;
+			out.y[index] = v.y;
+			out.z[index] = v.z;
+		}
+	}
+
+	void Matrix::TransformPoints(const Vector3Stream& points, Vector3Stream& out, int first, int last) const
+	{
+		int index = first;
+		if (GetSimdLevel() == SimdLevel::AVX2)
+		{
+			float* const pOut[3]{ out.x.data() + first, out.y.data() + first, out.z.data() + first };
+			index += TransformAVX2<3, true>(*this, points.x.data() + first, points.y.data() + first, points.z.data() + first, pOut, last - first);
+		}
+
+		for (; index < last; ++index)
+		{
+			const Vector3 p = TransformPoint(points.x[index], points.y[index], points.z[index]);
+			out.x[index] = p.x;
+			out.y[index] = p.y;
+			out.z[index] = p.z;
+		}
+	}
+
+	void Matrix::TransformPoints(const Vector3Stream& points, Vector4Stream& out, int first, int last) const
+	{
+		int index = first;
+		if (GetSimdLevel() == SimdLevel::AVX2)
+		{
+			float* const pOut[4]{ out.x.data() + first, out.y.data() + first, out.z.data() + first, out.w.data() + first };
+			index += TransformAVX2<4, true>(*this, points.x.data() + first, points.y.data() + first, points.z.data() + first, pOut, last - first);
+		}
+
+		for (; index < last; ++index)
+		{
+			const Vector4 p = TransformPoint(points.x[index], points.y[index], points.z[index], 1.f);
+			out.x[index] = p.x;
+			out.y[index] = p.y;
+			out.z[index] = p.z;
+			out.w[index] = p.w;
+		}
+	}
+
 	const Matrix& Matrix::Transpose()
 	{
 		Matrix result{};
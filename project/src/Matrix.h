@@ -3,6 +3,9 @@
 #include "Vector4.h"
 
 namespace dae {
+	struct Vector3Stream;
+	struct Vector4Stream;
+
 	struct Matrix
 	{
 		Matrix() = default;
@@ -28,6 +31,13 @@ namespace dae {
 		Vector4 TransformPoint(const Vector4& p) const;
 		Vector4 TransformPoint(float x, float y, float z, float w) const;
 
+		//Batched versions for the vertex stage, transform the range [first, last) of a stream into the same range of out.
+		//They run VERTEX_LANES vertices per iteration and match the single vertex functions bit for bit
+		void TransformVectors(const Vector3Stream& vectors, Vector3Stream& out, int first, int last) const;
+		void TransformPoints(const Vector3Stream& points, Vector3Stream& out, int first, int last) const;
+		//Points get w = 1, like TransformPoint(Vector3::ToVector4())
+		void TransformPoints(const Vector3Stream& points, Vector4Stream& out, int first, int last) const;
+
 		const Matrix& Transpose();
 		const Matrix& Inverse();
 
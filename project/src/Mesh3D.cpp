@@ -1,14 +1,54 @@
 #include "Mesh3D.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "RasterKernels.h"
+#include "Clipper.h"
+#include "VehicleShader.h"
+#include "FireShader.h"
 #include <memory.h>
-constexpr float eps = float( 1e-4);
-Mesh3D::Mesh3D(ID3D11Device* pDevice, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Effect* pEffect, bool toApplyTransparency) : m_pEffect(pEffect), m_ToApplyTransparency(toApplyTransparency)
+#include <thread>
+#include <array>
+#include <utility>
+
+namespace
+{
+	// Dispatch table index per shader: [displayMode][shadingMode][isNormalMap][shadingPrecision]
+	constexpr int NUM_SHADING_MODES{ 4 };
+	constexpr int NUM_SHADING_VARIANTS{ 3 * NUM_SHADING_MODES * 2 * 2 };
+
+	constexpr int GetShadingVariantIndex(DisplayMode displayMode, ShadingMode shadingMode, bool isNormalMap, ShadingPrecision shadingPrecision)
+	{
+		return ((int(displayMode) * NUM_SHADING_MODES + int(shadingMode)) * 2 + int(isNormalMap)) * 2 + int(shadingPrecision);
+	}
+
+	// Modes that don't shade ignore the other switches, so their entries share one instantiation
+	template<typename Shader, int index>
+	struct ShadingVariantAtIndex
+	{
+		static constexpr DisplayMode displayMode{ DisplayMode(index / (NUM_SHADING_MODES * 4)) };
+		static constexpr bool isShaded{ displayMode == DisplayMode::ShadingMode };
+
+		using Type = ShadingVariant<Shader, displayMode,
+			isShaded ? ShadingMode(index / 4 % NUM_SHADING_MODES) : ShadingMode::Combined,
+			isShaded && (index / 2 % 2) != 0,
+			isShaded ? ShadingPrecision(index % 2) : ShadingPrecision::Exact>;
+	};
+
+	template<typename Shader, int index>
+	using ShadingVariantAt = typename ShadingVariantAtIndex<Shader, index>::Type;
+}
+
+Mesh3D::Mesh3D(ID3D11Device* pDevice, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Effect* pEffect) : m_pEffect(pEffect)
 {
 	m_pUMesh = std::unique_ptr<Mesh>(new Mesh());
 	m_pUMesh->vertices = vertices;
 	m_pUMesh->indices = indices;
 	m_pUMesh->primitiveTopology = PrimitiveTopology::TriangleStrip;
+	m_VertexStreams.Assign(vertices);
+
+	//One binning chunk per hardware thread
+	m_NumBinningChunks = std::clamp(int(std::thread::hardware_concurrency()), 1, MAX_BINNING_CHUNKS);
+	SetFrameSlotCount(1);
 
 
 	//1. Create Vertex Layout
@@ -127,356 +167,613 @@ void Mesh3D::RenderGPU(const Vector3& cameraPosition, const Matrix& pWorldMatrix
 	}
 }
 
-void Mesh3D::RenderCPU(int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, bool isNormalMap, SDL_Surface* pBackBuffer, uint32_t* pBackBufferPixels, float* pDepthBufferPixels) const
+JobId Mesh3D::RenderCPU(JobGraph& graph, JobId vertexTransform, const std::vector<JobId>& dependencies, int frameSlot, int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, bool isNormalMap, ColorBuffer& colorBuffer, DepthBuffer& depthBuffer, HiZBuffer& hiZBuffer, TileClearState& clearState, VisibilityBuffer* pVisibilityBuffer, bool isOcclusionTested, bool isDepthPrepassed, ShadingPrecision shadingPrecision)
 {
-	bool isTriangleList = m_pUMesh->primitiveTopology == PrimitiveTopology::TriangleStrip;
-	// Parallelize over triangles
-#pragma omp parallel for
-	for (int inx = 0; inx < m_pUMesh->indices.size(); inx += (isTriangleList ? 3 : 1)) {
-
-		auto t0 = m_pUMesh->indices[inx];
-		auto t1 = m_pUMesh->indices[inx + 1];
-		auto t2 = m_pUMesh->indices[inx + 2];
-
-		////Perform clipping 
-		//std::vector<Vertex_Out> clippedVertices;
-		//std::vector<uint32_t> clippedIndices;
-		//ClipTriangle(mesh.vertices_out[t0], mesh.vertices_out[t1], mesh.vertices_out[t2], clippedVertices, clippedIndices);
-		//
-		//if (clippedVertices.size() < 3) continue; // If there are not enough vertices left after clipping, skip this triangle
-
-		// Skip degenerate triangles
-		if (t0 == t1 || t1 == t2 || t2 == t0) continue;
-
-		// Vertex positions
-		auto v0 = m_pUMesh->vertices_out[t0].position;
-		auto v1 = m_pUMesh->vertices_out[t1].position;
-		auto v2 = m_pUMesh->vertices_out[t2].position;
-
-		// Skip if any vertex is behind the camera (w < 0)
-		if (v0.w < 0 || v1.w < 0 || v2.w < 0) continue;
-
-		if (!CheckClipping(v0, v1, v2))
-		{
-			continue; // All vertices are outside the clip space, skip rendering
-		}
+	// Blended and bounding box output can't be deferred
+	if (m_Shader.isTransparent || displayMode == DisplayMode::BoundingBox)
+	{
+		pVisibilityBuffer = nullptr;
+	}
+	// Only opaque forward shading gains from a pre-pass, deferred shading already shades every pixel once
+	const bool isPrepassed = isDepthPrepassed && !m_Shader.isTransparent && displayMode != DisplayMode::BoundingBox && pVisibilityBuffer == nullptr;
+
+	// Nothing to perturb the normal with
+	isNormalMap = isNormalMap && m_Shader.hasNormalMap;
+
+	const bool isTriangleList = m_pUMesh->primitiveTopology == PrimitiveTopology::TriangleStrip;
+	const int indexStep = isTriangleList ? 3 : 1;
+	const int numTriangles = int(m_pUMesh->indices.size()) < 3 ? 0 : (int(m_pUMesh->indices.size()) - 3) / indexStep + 1;
 
-		ConvertToScreenSpace(float(width), float(height), v0, v1, v2);
+	//1. Triangle setup + binning, every chunk of triangles bins into its own lists
+	m_TileBinner.Resize(width, height);
+	m_TileBinner.Reset(m_NumBinningChunks);
+	m_TriangleSetups.resize(m_NumBinningChunks);
 
-		// Compute bounding box of the triangle
-		int minX = std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))));
-		int maxX = std::min(width, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
-		int minY = std::max(0, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))));
-		int maxY = std::min(height, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+	const uint32_t attributes = GetRequiredAttributes(displayMode, shadingMode, isNormalMap);
+	const VertexStreams_Out* pVerticesOut = &m_VerticesOut[frameSlot];
+	const bool isReversedZ = depthBuffer.IsReversedZ();
 
-		if (displayMode == DisplayMode::BoundingBox)
+	const JobId binning = graph.AddParallelFor(m_NumBinningChunks, 1, [=, this](int firstChunk, int lastChunk)
+	{
+		for (int chunk = firstChunk; chunk < lastChunk; ++chunk)
 		{
-			Uint32 color = SDL_MapRGB(pBackBuffer->format, 255, 255, 255);
-			SDL_Rect rect;
-			rect.x = minX;
-			rect.y = minY;
-			rect.w = maxX - minX;
-			rect.h = maxY - minY;
-			SDL_FillRect(pBackBuffer, &rect, color);
+			std::vector<TriangleSetup>& setups = m_TriangleSetups[chunk];
+			setups.clear();
+
+			Clipper clipper{};
+			clipper.SetViewport(width, height);
+			clipper.SetReversedZ(isReversedZ);
+
+			const int firstTriangle = int(int64_t(numTriangles) * chunk / m_NumBinningChunks);
+			const int lastTriangle = int(int64_t(numTriangles) * (chunk + 1) / m_NumBinningChunks);
+			for (int triangle = firstTriangle; triangle < lastTriangle; ++triangle)
+			{
+				const uint32_t t0 = m_pUMesh->indices[triangle * indexStep];
+				const uint32_t t1 = m_pUMesh->indices[triangle * indexStep + 1];
+				const uint32_t t2 = m_pUMesh->indices[triangle * indexStep + 2];
+
+				// Skip degenerate triangles
+				if (t0 == t1 || t1 == t2 || t2 == t0) continue;
+
+				// Only what this draw interpolates is read back from the streams
+				Vertex_Out vertex0, vertex1, vertex2;
+				pVerticesOut->Gather(t0, attributes, vertex0);
+				pVerticesOut->Gather(t1, attributes, vertex1);
+				pVerticesOut->Gather(t2, attributes, vertex2);
+
+				// Clipped polygon comes back as a fan, usually just the triangle itself
+				const int numVertices = clipper.ClipTriangle(vertex0, vertex1, vertex2);
+				for (int vertex = 1; vertex + 1 < numVertices; ++vertex)
+				{
+					TriangleSetup setup;
+					if (!SetupTriangle(clipper.GetVertex(0), clipper.GetVertex(vertex), clipper.GetVertex(vertex + 1), width, height, cullingMode, attributes, setup)) continue;
+
+					m_TileBinner.Bin(chunk, uint32_t(setups.size()), setup);
+					setups.push_back(setup);
+				}
+			}
 		}
-		else
-		{
-			// Edge vectors for barycentric coordinates
-			auto e0 = v2 - v1;
-			auto e1 = v0 - v2;
-			auto e2 = v1 - v0;
+	}, { vertexTransform });
 
-			Vector2 edge0_2D(e0.x, e0.y);
-			Vector2 edge1_2D(e1.x, e1.y);
-			Vector2 edge2_2D(e2.x, e2.y);
+	// Occlusion is only known once the earlier draws are done
+	m_IsOccluded = false;
+	JobId occlusionTest = INVALID_JOB;
+	if (isOcclusionTested)
+	{
+		std::vector<JobId> occlusionDependencies{ dependencies };
+		occlusionDependencies.push_back(vertexTransform);
 
-			float wProduct = v0.w * v1.w * v2.w;
+		occlusionTest = graph.AddJob([=, this, &hiZBuffer, &depthBuffer]()
+		{
+			TileRect bounds;
+			float minDepth, maxDepth;
+			m_IsOccluded = CalculateScreenBounds(frameSlot, width, height, bounds, minDepth, maxDepth) && hiZBuffer.IsOccluded(bounds, depthBuffer.GetNearestKey(minDepth, maxDepth));
+		}, occlusionDependencies);
+	}
 
-			auto area = std::abs(Vector2::Cross(edge0_2D, edge1_2D));
+	//2. Rasterization and shading, specialized for this draw's modes
+	std::vector<JobId> rasterDependencies{ dependencies };
+	rasterDependencies.push_back(binning);
+	rasterDependencies.push_back(occlusionTest);
+
+	DrawState draw;
+	draw.height = height;
+	draw.pLayout = &colorBuffer.GetLayout();
+	draw.pColorBuffer = &colorBuffer;
+	draw.pDepthBuffer = &depthBuffer;
+	draw.pHiZBuffer = &hiZBuffer;
+	draw.pClearState = &clearState;
+	draw.pVisibilityBuffer = pVisibilityBuffer;
+	draw.isPrepassed = isPrepassed;
+	draw.pShader = m_Shader.pShader.get();
+
+	const AddRasterJobsFunction addRasterJobs = m_Shader.selectRasterJobs(displayMode, shadingMode, isNormalMap, shadingPrecision);
+	return (this->*addRasterJobs)(graph, rasterDependencies, draw);
+}
 
-			// Parallelize over rows of pixels (py)
-#pragma omp parallel for
-			for (int py = minY; py < maxY; ++py) {
-				for (int px = minX; px < maxX; ++px) {
-					ColorRGB finalColor;
-					auto P = Vector2(px + 0.5f, py + 0.5f);
+template<typename Shader>
+Mesh3D::AddRasterJobsFunction Mesh3D::SelectRasterJobs(DisplayMode displayMode, ShadingMode shadingMode, bool isNormalMap, ShadingPrecision shadingPrecision)
+{
+	static constexpr auto table = []<int... indices>(std::integer_sequence<int, indices...>)
+	{
+		return std::array<AddRasterJobsFunction, sizeof...(indices)>{ &Mesh3D::AddRasterJobs<ShadingVariantAt<Shader, indices>>... };
+	}(std::make_integer_sequence<int, NUM_SHADING_VARIANTS>{});
 
-					auto p0 = P - Vector2(v1.x, v1.y);
-					auto p1 = P - Vector2(v2.x, v2.y);
-					auto p2 = P - Vector2(v0.x, v0.y);
+	return table[GetShadingVariantIndex(displayMode, shadingMode, isNormalMap, shadingPrecision)];
+}
 
-					auto weightP0 = Vector2::Cross(edge0_2D, p0) / area;
-					auto weightP1 = Vector2::Cross(edge1_2D, p1) / area;
-					auto weightP2 = Vector2::Cross(edge2_2D, p2) / area;
+template<typename Variant>
+JobId Mesh3D::AddRasterJobs(JobGraph& graph, const std::vector<JobId>& dependencies, const DrawState& draw)
+{
+	//1. Rasterize tiles, a tile is owned by a single job so depth and color writes never race
+	const JobId rasterization = graph.AddParallelFor(m_TileBinner.GetTileCount(), 1, [this, draw](int firstTile, int lastTile)
+	{
+		if (m_IsOccluded) return;
 
-					auto total= weightP0 + weightP1 + weightP2;
-					if (!(abs(total - 1) <= eps) && !(abs(total + 1) <= eps)) continue;
+		const auto rasterizeTile = [&](int tileIndex, const TileRect& tile, auto passTag)
+		{
+			constexpr RasterPass pass = decltype(passTag)::value;
 
-					if (cullingMode == CullingMode::Back)
-					{
-						if (!(weightP0 >= 0.f && weightP1 >= 0.f && weightP2 >= 0.f)) continue;
-					}
-					else if (cullingMode == CullingMode::Front)
+			//Walk chunks in order so triangles keep their submission order inside a tile (needed for blending)
+			for (int chunk = 0; chunk < m_NumBinningChunks; ++chunk)
+			{
+				const std::vector<TriangleSetup>& setups = m_TriangleSetups[chunk];
+				for (uint32_t triangleIndex : m_TileBinner.GetBin(chunk, tileIndex))
+				{
+					const TriangleSetup& triangle = setups[triangleIndex];
+
+					if constexpr (Variant::DISPLAY_MODE == DisplayMode::BoundingBox)
 					{
-						if (!(weightP0 < 0.f && weightP1 < 0.f && weightP2 < 0.f))
+						const int minX = std::max(triangle.minX, tile.minX);
+						const int maxX = std::min(triangle.maxX, tile.maxX);
+						const int minY = std::max(triangle.minY, tile.minY);
+						const int maxY = std::min(triangle.maxY, tile.maxY);
+						draw.pLayout->ForEachRun(minX, minY, maxX, maxY, [&](int firstIndex, int lastIndex)
 						{
-							continue;
-						}
+							draw.pColorBuffer->Fill(firstIndex, lastIndex, colors::White);
+						});
 					}
-					else if (cullingMode == CullingMode::No)
+					else
 					{
-						if (!((weightP0 < 0.f && weightP1 < 0.f && weightP2 < 0.f) || (weightP0 >= 0.f && weightP1 >= 0.f && weightP2 >= 0.f))) continue;
+						RasterizeTriangle<Variant, pass>(triangle, tile, draw, PackTriangleId(chunk, triangleIndex));
 					}
-				   
-					float interpolationScale0 = abs(weightP0);
-					float interpolationScale1 = abs(weightP1);
-					float interpolationScale2 = abs(weightP2);
-
-					// Compute z-buffer value for depth testing
-					float zBufferValue = 1.f / (1.f / v0.z * interpolationScale0 +
-						1.f / v1.z * interpolationScale1 +
-						1.f / v2.z * interpolationScale2);
-
-					if (zBufferValue < 0 || zBufferValue > 1) continue;
-
-					int pixelIndex = px + (py * width);
-
-					if (zBufferValue >= pDepthBufferPixels[pixelIndex]) continue;
-					
-					if (!m_ToApplyTransparency)
-					{
-						pDepthBufferPixels[pixelIndex] = zBufferValue;
-					}
-					
-
-					// Interpolated depth for final color calculation
-					float interpolatedDepth = wProduct / (v1.w * v2.w * interpolationScale0 +
-						v0.w * v2.w * interpolationScale1 +
-						v0.w * v1.w * interpolationScale2);
-					if (interpolatedDepth <= 0) continue;
-
-					// Texture sampling
-					Vertex_Out pixelVertex;
-
-					pixelVertex.position = (m_pUMesh->vertices[t0].position.ToPoint4() + m_pUMesh->vertices[t1].position.ToPoint4() + m_pUMesh->vertices[t2].position.ToPoint4()) / 3.f;
-					pixelVertex.position.z = zBufferValue;
-					pixelVertex.position.w = interpolatedDepth;
-
-
-					pixelVertex.uv = Vector2::Interpolate(m_pUMesh->vertices_out[t0].uv, m_pUMesh->vertices_out[t1].uv, m_pUMesh->vertices_out[t2].uv,
-						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
+				}
+			}
+		};
 
-					pixelVertex.normal = Vector3::Interpolate(m_pUMesh->vertices_out[t0].normal, m_pUMesh->vertices_out[t1].normal, m_pUMesh->vertices_out[t2].normal,
-						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
-					pixelVertex.normal.Normalize();
+		for (int tileIndex = firstTile; tileIndex < lastTile; ++tileIndex)
+		{
+			// Tiles without triangles stay as they are, not even cleared
+			bool isTouched = false;
+			for (int chunk = 0; chunk < m_NumBinningChunks && !isTouched; ++chunk)
+			{
+				isTouched = !m_TileBinner.GetBin(chunk, tileIndex).empty();
+			}
+			if (!isTouched) continue;
 
+			const TileRect tile = m_TileBinner.GetTileRect(tileIndex);
+			draw.pClearState->ClearOnFirstTouch(tileIndex, tile, *draw.pColorBuffer, *draw.pDepthBuffer);
 
-					pixelVertex.tangent = Vector3::Interpolate(m_pUMesh->vertices_out[t0].tangent, m_pUMesh->vertices_out[t1].tangent, m_pUMesh->vertices_out[t2].tangent,
-						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
-					pixelVertex.tangent.Normalize();
+			// The pre-pass walks the tile twice while its depth is still in cache
+			if (draw.isPrepassed)
+			{
+				rasterizeTile(tileIndex, tile, RasterPassTag<RasterPass::DepthOnly>{});
+				rasterizeTile(tileIndex, tile, RasterPassTag<RasterPass::Shading>{});
+			}
+			else
+			{
+				rasterizeTile(tileIndex, tile, RasterPassTag<RasterPass::Combined>{});
+			}
 
-					pixelVertex.viewDirection = Vector3::Interpolate(m_pUMesh->vertices_out[t0].viewDirection, m_pUMesh->vertices_out[t1].viewDirection, m_pUMesh->vertices_out[t2].viewDirection,
-						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
-					pixelVertex.viewDirection.Normalize();
+			draw.pHiZBuffer->UpdateTile(tile);
+		}
+	}, dependencies);
 
-					// If texture mapping is enabled, sample the texture
-					if (displayMode == DisplayMode::DepthBuffer)
-					{
-						auto clampedValue = std::clamp(Remap(zBufferValue, 0.995f, 1.f, 0.f, 1.f), 0.f, 1.f);
-						finalColor = ColorRGB(clampedValue, clampedValue, clampedValue);
-					}
-					if (displayMode == DisplayMode::ShadingMode)
-					{
-						if (m_ToApplyTransparency)
-						{
-							ColorRGB existingPixelColor;
-							uint32_t existingPixel = pBackBufferPixels[pixelIndex];
-							uint8_t existingR, existingG, existingB;
-							SDL_GetRGB(existingPixel, pBackBuffer->format, &existingR, &existingG, &existingB);
-							existingPixelColor = { existingR / 255.0f, existingG / 255.0f, existingB / 255.0f };
+	if (draw.pVisibilityBuffer == nullptr) return rasterization;
 
-							//existingPixelColor.MaxToOne();
+	//2. Deferred: shade every visible pixel exactly once, rows in screen order, and leave the visibility buffer empty again
+	constexpr int resolveRows{ 16 };
+	static_assert(resolveRows % PIXEL_BLOCK_SIZE == 0, "Row bands have to cover whole block rows");
+	return graph.AddParallelFor(draw.height, resolveRows, [this, draw](int firstRow, int lastRow)
+	{
+		VisibilityBuffer* pVisibilityBuffer = draw.pVisibilityBuffer;
 
-							existingPixelColor.r = std::clamp(existingPixelColor.r, 0.f, 1.f);
-							existingPixelColor.g = std::clamp(existingPixelColor.g, 0.f, 1.f);
-							existingPixelColor.b = std::clamp(existingPixelColor.b, 0.f, 1.f);
+		// Neighbouring pixels mostly belong to the same triangle, a batch is shaded when full or when the triangle changes
+		FragmentBatch batch;
+		const TriangleSetup* pBatchTriangle = nullptr;
+		for (int pixelIndex = draw.pLayout->GetRowStart(firstRow); pixelIndex < draw.pLayout->GetRowStart(lastRow); ++pixelIndex)
+		{
+			const uint32_t triangleId = pVisibilityBuffer->triangleIds[pixelIndex];
+			if (triangleId == INVALID_TRIANGLE_ID) continue;
 
-							finalColor = PixelShading(pixelVertex, shadingMode, isNormalMap, existingPixelColor);
-						}
-						else
-						{
-							finalColor = PixelShading(pixelVertex, shadingMode, isNormalMap);
-						}
-					}
-					finalColor.r = std::clamp(finalColor.r, 0.f, 1.f); //Clamp because MaxToOne version has some artifacts
-					finalColor.g = std::clamp(finalColor.g, 0.f, 1.f);
-					finalColor.b = std::clamp(finalColor.b, 0.f, 1.f);
-
-					pBackBufferPixels[pixelIndex] = SDL_MapRGB(pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255.f),
-						static_cast<uint8_t>(finalColor.g * 255.f),
-						static_cast<uint8_t>(finalColor.b * 255.f));
-				}
+			const TriangleSetup& triangle = m_TriangleSetups[triangleId >> TRIANGLE_INDEX_BITS][triangleId & TRIANGLE_INDEX_MASK];
+			if (&triangle != pBatchTriangle && batch.count > 0)
+			{
+				ShadeFragments<Variant>(*pBatchTriangle, batch, draw);
+			}
+			pBatchTriangle = &triangle;
+
+			// Depth comes from the weights again, the depth buffer may hold it quantized or not at all (compressed blocks)
+			const float weight0 = pVisibilityBuffer->weights0[pixelIndex];
+			const float weight1 = pVisibilityBuffer->weights1[pixelIndex];
+			if (batch.Add(pixelIndex, weight0, weight1, draw.pDepthBuffer->ToForwardDepth(InterpolateDepth(triangle, weight0, weight1))))
+			{
+				ShadeFragments<Variant>(triangle, batch, draw);
 			}
+
+			pVisibilityBuffer->triangleIds[pixelIndex] = INVALID_TRIANGLE_ID;
+		}
+		if (batch.count > 0)
+		{
+			ShadeFragments<Variant>(*pBatchTriangle, batch, draw);
 		}
+	}, { rasterization });
+}
+
+bool Mesh3D::CalculateScreenBounds(int frameSlot, int width, int height, TileRect& bounds, float& minDepth, float& maxDepth) const
+{
+	const std::vector<VertexBounds>& batchBounds = m_VertexBounds[frameSlot];
+	if (batchBounds.empty()) return false;
 
+	VertexBounds meshBounds{ batchBounds.front() };
+	for (const VertexBounds& batch : batchBounds)
+	{
+		if (!batch.isBounded) return false;
+
+		meshBounds.minX = std::min(meshBounds.minX, batch.minX);
+		meshBounds.minY = std::min(meshBounds.minY, batch.minY);
+		meshBounds.minZ = std::min(meshBounds.minZ, batch.minZ);
+		meshBounds.maxX = std::max(meshBounds.maxX, batch.maxX);
+		meshBounds.maxY = std::max(meshBounds.maxY, batch.maxY);
+		meshBounds.maxZ = std::max(meshBounds.maxZ, batch.maxZ);
 	}
+
+	// The screen mapping is monotonic, so the NDC extremes map to the screen extremes (y flips)
+	const float minX = width * (meshBounds.minX * 0.5f + 0.5f);
+	const float maxX = width * (meshBounds.maxX * 0.5f + 0.5f);
+	const float minY = height * ((1.0f - meshBounds.maxY) * 0.5f);
+	const float maxY = height * ((1.0f - meshBounds.minY) * 0.5f);
+	minDepth = meshBounds.minZ;
+	maxDepth = meshBounds.maxZ;
+
+	bounds.minX = static_cast<int>(std::floor(std::clamp(minX, 0.f, float(width))));
+	bounds.minY = static_cast<int>(std::floor(std::clamp(minY, 0.f, float(height))));
+	bounds.maxX = static_cast<int>(std::ceil(std::clamp(maxX, 0.f, float(width))));
+	bounds.maxY = static_cast<int>(std::ceil(std::clamp(maxY, 0.f, float(height))));
+	return true;
 }
 
-void Mesh3D::SetCullingMode(CullingMode cullingMode, ID3D11DeviceContext* context)
-{	
-	switch (cullingMode)
+Mesh3D::VertexBounds Mesh3D::CalculateVertexBounds(const Vector4Stream& positions, int first, int last)
+{
+	constexpr float maxFloat = std::numeric_limits<float>::max();
+	VertexBounds bounds{ true, maxFloat, maxFloat, maxFloat, -maxFloat, -maxFloat, -maxFloat };
+	for (int index = first; index < last; ++index)
 	{
-	case CullingMode::Back:
-		m_pEffect->SetCullingMode(D3D11_CULL_BACK);
-		m_pEffect->ApplyCullingMode(context);
-		break;
-	case CullingMode::Front:
-		m_pEffect->SetCullingMode(D3D11_CULL_FRONT);
-		m_pEffect->ApplyCullingMode(context);
-		break;
-	case CullingMode::No:
-		m_pEffect->SetCullingMode(D3D11_CULL_NONE);
-		m_pEffect->ApplyCullingMode(context);
-		break;
+		// Vertices behind the camera have no meaningful projection
+		const float w = positions.w[index];
+		if (w <= 0.f) return {};
+
+		const float ndcX = positions.x[index] / w;
+		const float ndcY = positions.y[index] / w;
+		const float ndcZ = positions.z[index] / w;
+		bounds.minX = std::min(bounds.minX, ndcX);
+		bounds.minY = std::min(bounds.minY, ndcY);
+		bounds.minZ = std::min(bounds.minZ, ndcZ);
+		bounds.maxX = std::max(bounds.maxX, ndcX);
+		bounds.maxY = std::max(bounds.maxY, ndcY);
+		bounds.maxZ = std::max(bounds.maxZ, ndcZ);
 	}
+	return bounds;
 }
 
-void Mesh3D::VertexTransformationFunction(const Camera& camera, const Matrix& rotationMatrix)
+bool Mesh3D::SetupTriangle(const Vertex_Out& vertex0, const Vertex_Out& vertex1, const Vertex_Out& vertex2, int width, int height, CullingMode cullingMode, uint32_t attributes, TriangleSetup& setup) const
 {
-	// Precompute transformation matrix
-	auto rotatedWorldMatrix = rotationMatrix * m_pUMesh->worldMatrix;
-	auto overallMatrix = rotatedWorldMatrix * camera.viewMatrix * camera.projectionMatrix;
+	// Perspective divide, the clipper guarantees w > 0 (w itself is kept as view depth)
+	setup.v0 = vertex0.position / vertex0.position.w;
+	setup.v1 = vertex1.position / vertex1.position.w;
+	setup.v2 = vertex2.position / vertex2.position.w;
 
-	// Resize vertices_out to match input vertices
-	m_pUMesh->vertices_out.resize(m_pUMesh->vertices.size());
+	ConvertToScreenSpace(float(width), float(height), setup.v0, setup.v1, setup.v2);
 
-	// Transform vertices in parallel
-#pragma omp parallel for
-	for (size_t i = 0; i < m_pUMesh->vertices.size(); ++i) {
-		m_pUMesh->vertices_out[i].normal = rotatedWorldMatrix.TransformVector(m_pUMesh->vertices[i].normal).Normalized();
+	// Snap to the sub-pixel grid, all coverage math below is exact integer math
+	// (the guard band keeps coordinates small enough for 32-bit a/b and 64-bit c)
+	const int32_t fixedX[3]{ int32_t(std::lround(setup.v0.x * SUBPIXEL_SCALE)), int32_t(std::lround(setup.v1.x * SUBPIXEL_SCALE)), int32_t(std::lround(setup.v2.x * SUBPIXEL_SCALE)) };
+	const int32_t fixedY[3]{ int32_t(std::lround(setup.v0.y * SUBPIXEL_SCALE)), int32_t(std::lround(setup.v1.y * SUBPIXEL_SCALE)), int32_t(std::lround(setup.v2.y * SUBPIXEL_SCALE)) };
 
-		m_pUMesh->vertices_out[i].tangent = rotatedWorldMatrix.TransformVector(m_pUMesh->vertices[i].tangent).Normalized();
+	// Culling is decided once per triangle from the signed area, clockwise (positive) is front facing
+	const int64_t area = int64_t(fixedX[1] - fixedX[0]) * (fixedY[2] - fixedY[0]) - int64_t(fixedY[1] - fixedY[0]) * (fixedX[2] - fixedX[0]);
+	if (area == 0) return false;
 
+	const bool isFrontFacing = area > 0;
+	if ((cullingMode == CullingMode::Back && !isFrontFacing) || (cullingMode == CullingMode::Front && isFrontFacing)) return false;
 
-		auto rotatedWorldPosition = rotatedWorldMatrix.TransformPoint(m_pUMesh->vertices[i].position);
-		m_pUMesh->vertices_out[i].viewDirection = rotatedWorldPosition - camera.origin;
-		m_pUMesh->vertices_out[i].viewDirection.Normalize();
+	// Compute bounding box of the triangle
+	setup.minX = std::max(0, std::min({ fixedX[0], fixedX[1], fixedX[2] }) >> SUBPIXEL_BITS);
+	setup.maxX = std::min(width, (std::max({ fixedX[0], fixedX[1], fixedX[2] }) + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS);
+	setup.minY = std::max(0, std::min({ fixedY[0], fixedY[1], fixedY[2] }) >> SUBPIXEL_BITS);
+	setup.maxY = std::min(height, (std::max({ fixedY[0], fixedY[1], fixedY[2] }) + SUBPIXEL_SCALE - 1) >> SUBPIXEL_BITS);
 
-		Vector4 viewSpacePosition = overallMatrix.TransformPoint(m_pUMesh->vertices[i].position.ToVector4());
-		Vector4 projectionSpacePosition = viewSpacePosition / viewSpacePosition.w;
+	if (setup.minX >= setup.maxX || setup.minY >= setup.maxY) return false;
 
-		m_pUMesh->vertices_out[i].position = projectionSpacePosition;
-		m_pUMesh->vertices_out[i].uv = m_pUMesh->vertices[i].uv;
-	}
-}
+	// Edge function coefficients, edge i runs between the two vertices opposite to vertex i
+	for (int edge = 0; edge < 3; ++edge)
+	{
+		const int start = (edge + 1) % 3;
+		const int end = (edge + 2) % 3;
 
-ColorRGB Mesh3D::PixelShading(Vertex_Out& v, ShadingMode shadingMode, bool isNormalMap, ColorRGB existingPixelColor) const
-{
-	ColorRGB finalColor;
+		setup.edgeA[edge] = fixedY[start] - fixedY[end];
+		setup.edgeB[edge] = fixedX[end] - fixedX[start];
+		setup.edgeC[edge] = int64_t(fixedX[start]) * fixedY[end] - int64_t(fixedY[start]) * fixedX[end];
+		setup.isTopLeft[edge] = setup.edgeA[edge] > 0 || (setup.edgeA[edge] == 0 && setup.edgeB[edge] > 0);
 
-	Vector3 lightDirection = { .577f, -.577f,  .577f };
-	constexpr float lightIntensity = 7.f;
-	constexpr float shininess = 25.f;
-	constexpr ColorRGB ambient = { .025f,.025f,.025f };
+		// Normalize the winding of surviving back faces, the pixel loop only ever tests for positive edges.
+		// Their fill rule is mirrored as well, so shared edges still belong to exactly one triangle.
+		if (!isFrontFacing)
+		{
+			setup.edgeA[edge] = -setup.edgeA[edge];
+			setup.edgeB[edge] = -setup.edgeB[edge];
+			setup.edgeC[edge] = -setup.edgeC[edge];
+			setup.isTopLeft[edge] = !setup.isTopLeft[edge];
+		}
+	}
 
-	
-	if (isNormalMap)
+	// Weight planes from the float positions, unless those disagree with the snapped winding (slivers)
+	Vector2 weightPositions[3]{ { setup.v0.x, setup.v0.y }, { setup.v1.x, setup.v1.y }, { setup.v2.x, setup.v2.y } };
+	float weightArea = (weightPositions[1].x - weightPositions[0].x) * (weightPositions[2].y - weightPositions[0].y) - (weightPositions[1].y - weightPositions[0].y) * (weightPositions[2].x - weightPositions[0].x);
+	if (weightArea == 0.f || (weightArea > 0.f) != (area > 0))
 	{
-		Vector3 binormal = Vector3::Cross(v.normal, v.tangent);
-		//Matrix tangentSpaceAxis = Matrix{ v.tangent, binormal, v.normal, Vector3::Zero };
-		ColorRGB normalMapSample = m_pEffect->GetNormalTexture()->Sample(v.uv);
-		v.normal = (v.tangent * (2.f * normalMapSample.r - 1.f) + binormal * (2.f * normalMapSample.g - 1.f) + v.normal * (2.f * normalMapSample.b - 1.f)).Normalized();
-	}  
+		for (int vertex = 0; vertex < 3; ++vertex)
+		{
+			weightPositions[vertex] = { float(fixedX[vertex]) / SUBPIXEL_SCALE, float(fixedY[vertex]) / SUBPIXEL_SCALE };
+		}
+		weightArea = float(area) / (SUBPIXEL_SCALE * SUBPIXEL_SCALE);
+	}
 
-	float cosOfAngle{ Vector3::Dot(v.normal, -lightDirection) };
+	const float invWeightArea = 1.f / weightArea;
+	for (int edge = 0; edge < 2; ++edge)
+	{
+		const Vector2& start = weightPositions[(edge + 1) % 3];
+		const Vector2& end = weightPositions[(edge + 2) % 3];
 
-	if (cosOfAngle < 0.f && !m_ToApplyTransparency) return ColorRGB(0.f, 0.f, 0.f);
+		setup.weightA[edge] = (start.y - end.y) * invWeightArea;
+		setup.weightB[edge] = (end.x - start.x) * invWeightArea;
+	}
+	setup.weightOriginX = weightPositions[2].x;
+	setup.weightOriginY = weightPositions[2].y;
 
-	ColorRGB observedArea = { cosOfAngle, cosOfAngle, cosOfAngle };
+	setup.invZ[0] = 1.f / setup.v0.z;
+	setup.invZ[1] = 1.f / setup.v1.z;
+	setup.invZ[2] = 1.f / setup.v2.z;
+	setup.minDepth = std::min({ setup.v0.z, setup.v1.z, setup.v2.z });
+	setup.maxDepth = std::max({ setup.v0.z, setup.v1.z, setup.v2.z });
 
-	const Texture* diffuseTexturePtr = m_pEffect->GetDiffuseTexture();
-	ColorRGB diffuse;
-	if (diffuseTexturePtr != nullptr)
+	SetupAttributePlanes(setup, vertex0, vertex1, vertex2, attributes);
+	return true;
+}
+
+uint32_t Mesh3D::GetRequiredAttributes(DisplayMode displayMode, ShadingMode shadingMode, bool isNormalMap) const
+{
+	// Depth and bounding box views only need the position
+	if (displayMode != DisplayMode::ShadingMode) return AttributeNone;
+
+	return m_Shader.getVaryings(shadingMode, isNormalMap);
+}
+
+template<typename Variant, RasterPass pass>
+void Mesh3D::RasterizeTriangle(const TriangleSetup& triangle, const TileRect& tile, const DrawState& draw, uint32_t triangleId) const
+{
+	const PixelLayout& layout = *draw.pLayout;
+	DepthBuffer& depthBuffer = *draw.pDepthBuffer;
+	HiZBuffer& hiZBuffer = *draw.pHiZBuffer;
+
+	// Coverage and depth are resolved by the kernel, only surviving pixels get shaded (forward) or recorded (deferred).
+	// Forward shading collects them in batches, the last partial one is shaded once the triangle is done
+	FragmentBatch batch;
+	const auto shadePixel = [&](int pixelIndex, float weight0, float weight1, float zBufferValue)
 	{
-		if (!m_ToApplyTransparency)
+		if (batch.Add(pixelIndex, weight0, weight1, depthBuffer.ToForwardDepth(zBufferValue)))
 		{
-			diffuse = Lambert(diffuseTexturePtr->Sample(v.uv));
+			ShadeFragments<Variant>(triangle, batch, draw);
 		}
-		else
+	};
+
+	// Coarse rejection: no pixel of the triangle is closer than its nearest vertex, after the pre-pass it may still be just as close
+	const float nearestKey = depthBuffer.GetNearestKey(triangle.minDepth, triangle.maxDepth);
+	const auto isRejected = [nearestKey](float maxKey) { return pass == RasterPass::Shading ? nearestKey > maxKey : nearestKey >= maxKey; };
+	if (isRejected(hiZBuffer.GetTileMaxDepth(tile))) return;
+
+	const int minX = std::max(triangle.minX, tile.minX);
+	const int maxX = std::min(triangle.maxX, tile.maxX);
+	const int minY = std::max(triangle.minY, tile.minY);
+	const int maxY = std::min(triangle.maxY, tile.maxY);
+
+	constexpr DepthTest depthTest = pass == RasterPass::Shading ? DepthTest::Equal : DepthTest::Less;
+	constexpr bool writeDepth = !Variant::IS_TRANSPARENT && pass != RasterPass::Shading;
+	const SimdLevel simdLevel = GetSimdLevel();
+	const auto scanBlock = [&](const TileRect& block, const auto& depthAccess, const auto& fragmentFunc)
+	{
+		// Nothing gets compared against an unbounded buffer, every covered pixel passes
+		constexpr DepthTest blockTest = std::is_same_v<std::remove_cvref_t<decltype(depthAccess)>, UnboundedDepthAccess> ? DepthTest::Less : depthTest;
+		switch (simdLevel)
 		{
-			ColorRGBA sampleWithAlpha = diffuseTexturePtr->SampleWithAlpha(v.uv);
-			ColorRGB currentColor = ColorRGBA::GetColorRGB(sampleWithAlpha);
-			float alphaValue = sampleWithAlpha.a;
-			diffuse = (currentColor * alphaValue) + (existingPixelColor * (1.0f - alphaValue));
+		case SimdLevel::AVX2:
+			return ScanTriangleAVX2<blockTest>(triangle, block, layout, writeDepth, depthAccess, fragmentFunc);
+		case SimdLevel::SSE41:
+			return ScanTriangleSSE41<blockTest>(triangle, block, layout, writeDepth, depthAccess, fragmentFunc);
+		default:
+			return ScanTriangleScalar<blockTest>(triangle, block, layout, writeDepth, depthAccess, fragmentFunc);
 		}
-	}
-	else
+	};
+	const auto scanBlocks = [&](const auto& depthAccess, const auto& fragmentFunc)
 	{
-		diffuse = colors::Black;
-	}
+		for (int blockY = minY / HIZ_BLOCK_SIZE; blockY <= (maxY - 1) / HIZ_BLOCK_SIZE; ++blockY)
+		{
+			for (int blockX = minX / HIZ_BLOCK_SIZE; blockX <= (maxX - 1) / HIZ_BLOCK_SIZE; ++blockX)
+			{
+				if (isRejected(hiZBuffer.GetBlockMaxDepth(blockX, blockY))) continue;
+
+				TileRect block;
+				block.minX = std::max(blockX * HIZ_BLOCK_SIZE, minX);
+				block.minY = std::max(blockY * HIZ_BLOCK_SIZE, minY);
+				block.maxX = std::min((blockX + 1) * HIZ_BLOCK_SIZE, maxX);
+				block.maxY = std::min((blockY + 1) * HIZ_BLOCK_SIZE, maxY);
+
+				if (pass == RasterPass::Shading && !depthBuffer.IsBlockExpanded(blockX, blockY))
+				{
+					// The triangle that left its plane in the block is visible all over it, nothing else drew there
+					if (depthBuffer.IsBlockPlaneOf(blockX, blockY, triangle))
+					{
+						scanBlock(block, UnboundedDepthAccess{}, fragmentFunc);
+						continue;
+					}
+					if (depthBuffer.IsBlockCleared(blockX, blockY)) continue;
+					depthBuffer.ExpandBlock(blockX, blockY);
+				}
+				else if (!depthBuffer.IsBlockExpanded(blockX, blockY))
+				{
+					// A triangle in front of the whole compressed block that covers it completely just replaces its plane
+					const bool isWholeBlock = block.minX == blockX * HIZ_BLOCK_SIZE && block.minY == blockY * HIZ_BLOCK_SIZE &&
+						block.maxX == std::min((blockX + 1) * HIZ_BLOCK_SIZE, tile.maxX) && block.maxY == std::min((blockY + 1) * HIZ_BLOCK_SIZE, tile.maxY);
+					if (writeDepth && isWholeBlock && IsCoveringBlock(triangle, block) && depthBuffer.IsInFrontOfBlock(blockX, blockY, triangle.minDepth, triangle.maxDepth))
+					{
+						scanBlock(block, UnboundedDepthAccess{}, fragmentFunc);
+						depthBuffer.SetBlockPlane(blockX, blockY, triangle);
+						hiZBuffer.UpdateBlock(blockX, blockY, depthBuffer);
+						continue;
+					}
+					depthBuffer.ExpandBlock(blockX, blockY);
+				}
 
-	const Texture* glossTexturePtr = m_pEffect->GetGlossinessTexture();
-	ColorRGB gloss;
-	if (glossTexturePtr != nullptr)
-	{
-		gloss = glossTexturePtr->Sample(v.uv);
-	}
-	else
+				if (scanBlock(block, depthAccess, fragmentFunc))
+				{
+					hiZBuffer.UpdateBlock(blockX, blockY, depthBuffer);
+				}
+			}
+		}
+	};
+
+	VisitDepthAccess(depthBuffer, [&](const auto& depthAccess)
 	{
-		gloss = colors::Black;
-	}
-	
-	float exp = gloss.r * shininess;
+		if constexpr (pass == RasterPass::DepthOnly)
+		{
+			scanBlocks(depthAccess, DepthOnlyFragment{});
+		}
+		else if (draw.pVisibilityBuffer != nullptr)
+		{
+			scanBlocks(depthAccess, VisibilityFragment{ draw.pVisibilityBuffer, triangleId });
+		}
+		else
+		{
+			scanBlocks(depthAccess, shadePixel);
+		}
+	});
 
-	const Texture* specularTexturePtr = m_pEffect->GetSpecularTexture();
-	ColorRGB specular;
-	if (specularTexturePtr != nullptr)
+	if (batch.count > 0)
 	{
-		specular = Phong(specularTexturePtr->Sample(v.uv), exp, -lightDirection, v.viewDirection, v.normal);
+		ShadeFragments<Variant>(triangle, batch, draw);
 	}
-	else
+}
+
+template<typename Variant>
+void Mesh3D::ShadeFragments(const TriangleSetup& triangle, FragmentBatch& batch, const DrawState& draw) const
+{
+	// Lanes past the last fragment repeat the first one, so they never compute with garbage
+	for (int lane = batch.count; lane < SHADING_BATCH_SIZE; ++lane)
 	{
-		specular = colors::Black;
+		batch.weights0[lane] = batch.weights0[0];
+		batch.weights1[lane] = batch.weights1[0];
+		batch.depths[lane] = batch.depths[0];
 	}
 
-	switch (shadingMode)
+	for (int first = 0; first < batch.count; first += SHADING_LANES)
 	{
-	case ShadingMode::ObservedArea:
-		finalColor += observedArea;
-		break;
-
-	case ShadingMode::Diffuse:
-		finalColor += diffuse * observedArea * lightIntensity;
-		break;
-
-	case ShadingMode::Specular:
-		finalColor += specular;
-		break;
-
-	case ShadingMode::Combined:
-		if (!m_ToApplyTransparency)
+		// Perspective-correct attributes from the precomputed planes
+		VaryingLanes varyings;
+		const FloatLanes interpolatedDepth = InterpolateAttributes<Variant::PRECISION>(triangle, FloatLanes::Load(&batch.weights0[first]), FloatLanes::Load(&batch.weights1[first]), varyings);
+		int laneBits = ToLaneBits(interpolatedDepth > 0.f) & ((1 << std::min(SHADING_LANES, batch.count - first)) - 1);
+		if (laneBits == 0) continue;
+
+		ColorLanes finalColor;
+		if constexpr (Variant::DISPLAY_MODE == DisplayMode::DepthBuffer)
 		{
-			finalColor += ambient + specular + diffuse * observedArea * lightIntensity;
+			const FloatLanes zBufferValue = FloatLanes::Load(&batch.depths[first]);
+			const FloatLanes clampedValue = Clamp01(Remap(zBufferValue, 0.995f, 1.f, 0.f, 1.f));
+			finalColor = ColorLanes{ clampedValue, clampedValue, clampedValue };
 		}
 		else
 		{
-			finalColor = diffuse;
+			// Only blending shaders read the color underneath
+			ColorLanes targetColor{};
+			if constexpr (Variant::IS_TRANSPARENT)
+			{
+				alignas(16) float targetChannels[3][SHADING_LANES]{};
+				for (int lane = 0; lane < SHADING_LANES && first + lane < batch.count; ++lane)
+				{
+					const ColorRGB existingPixelColor = draw.pColorBuffer->Load(batch.pixelIndices[first + lane]);
+					targetChannels[0][lane] = existingPixelColor.r;
+					targetChannels[1][lane] = existingPixelColor.g;
+					targetChannels[2][lane] = existingPixelColor.b;
+				}
+
+				//targetColor.MaxToOne();
+
+				targetColor.r = Clamp01(FloatLanes::Load(targetChannels[0]));
+				targetColor.g = Clamp01(FloatLanes::Load(targetChannels[1]));
+				targetColor.b = Clamp01(FloatLanes::Load(targetChannels[2]));
+			}
+
+			const typename Variant::Shader& shader = *static_cast<const typename Variant::Shader*>(draw.pShader);
+			finalColor = shader.template ShadePixels<Variant::SHADING_MODE, Variant::IS_NORMAL_MAP, Variant::PRECISION>(varyings, targetColor);
 		}
 
+		// Clamped and packed for all lanes at once (BGRA8) or at the resolve (RGBA16F), MaxToOne version has some artifacts
+		draw.pColorBuffer->Store(&batch.pixelIndices[first], laneBits, finalColor);
+	}
+	batch.count = 0;
+}
+
+void Mesh3D::SetCullingMode(CullingMode cullingMode, ID3D11DeviceContext* context)
+{	
+	switch (cullingMode)
+	{
+	case CullingMode::Back:
+		m_pEffect->SetCullingMode(D3D11_CULL_BACK);
+		m_pEffect->ApplyCullingMode(context);
+		break;
+	case CullingMode::Front:
+		m_pEffect->SetCullingMode(D3D11_CULL_FRONT);
+		m_pEffect->ApplyCullingMode(context);
+		break;
+	case CullingMode::No:
+		m_pEffect->SetCullingMode(D3D11_CULL_NONE);
+		m_pEffect->ApplyCullingMode(context);
 		break;
 	}
+}
 
-	return finalColor;
+void Mesh3D::SetFrameSlotCount(int count)
+{
+	m_VerticesOut.resize(count);
+	m_VertexBounds.resize(count);
+	m_TransformKeys.assign(count, TransformKey{});
 }
 
-bool Mesh3D::CheckClipping(const Vector4& v0, const Vector4& v1, const Vector4& v2) const
+JobId Mesh3D::VertexTransformationFunction(JobGraph& graph, int frameSlot, const Camera& camera, const Matrix& rotationMatrix, uint32_t rotationVersion)
 {
-	if ((v0.x < -1 || v0.x > 1 || v0.y < -1 || v0.y > 1 || v0.z < 0 || v0.z > 1) ||
-		(v1.x < -1 || v1.x > 1 || v1.y < -1 || v1.y > 1 || v1.z < 0 || v1.z > 1) ||
-		(v2.x < -1 || v2.x > 1 || v2.y < -1 || v2.y > 1 || v2.z < 0 || v2.z > 1) ) return false;
+	// Nothing moved since this slot was last transformed
+	TransformKey& key = m_TransformKeys[frameSlot];
+	if (key.isValid && key.cameraVersion == camera.version && key.rotationVersion == rotationVersion) return INVALID_JOB;
+	key = { true, camera.version, rotationVersion };
 
-	return true;
+	// Precompute transformation matrix
+	VertexConstants constants;
+	constants.world = rotationMatrix * m_pUMesh->worldMatrix;
+	constants.worldViewProjection = constants.world * camera.viewMatrix * camera.projectionMatrix;
+	constants.cameraOrigin = camera.origin;
+
+	return (this->*m_Shader.addVertexJobs)(graph, frameSlot, constants);
+}
+
+template<typename Shader>
+JobId Mesh3D::AddVertexJobs(JobGraph& graph, int frameSlot, const VertexConstants& constants)
+{
+	const Shader* pShader = static_cast<const Shader*>(m_Shader.pShader.get());
+
+	// Resize the output slot to match input vertices
+	VertexStreams_Out* pVerticesOut = &m_VerticesOut[frameSlot];
+	pVerticesOut->Resize(size_t(m_VertexStreams.GetCount()));
+
+	// Transform vertices in parallel batches, a multiple of VERTEX_LANES so only the last one has a scalar tail
+	constexpr int batchSize{ 128 * VERTEX_LANES };
+	std::vector<VertexBounds>* pBatchBounds = &m_VertexBounds[frameSlot];
+	pBatchBounds->resize(size_t((m_VertexStreams.GetCount() + batchSize - 1) / batchSize));
+
+	return graph.AddParallelFor(m_VertexStreams.GetCount(), batchSize, [=, this](int first, int last)
+	{
+		pShader->ShadeVertices(m_VertexStreams, first, last, constants, *pVerticesOut);
+		// Bounded while the batch is still in cache, the dirty rect and the occlusion test only merge these
+		(*pBatchBounds)[first / batchSize] = CalculateVertexBounds(pVerticesOut->position, first, last);
+	});
 }
 
 void Mesh3D::ConvertToScreenSpace(float width, float height, Vector4& v0, Vector4& v1, Vector4& v2) const
@@ -490,3 +787,21 @@ void Mesh3D::ConvertToScreenSpace(float width, float height, Vector4& v0, Vector
 	v2.x = width * (v2.x * 0.5f + 0.5f);
 	v2.y = height * ((1.0f - v2.y) * 0.5f);
 }
+
+template<SoftwareShader Shader>
+void Mesh3D::SetSoftwareShader(std::shared_ptr<const Shader> pShader)
+{
+	m_Shader.isTransparent = Shader::IS_TRANSPARENT;
+	m_Shader.hasNormalMap = pShader->HasNormalMap();
+	m_Shader.getVaryings = &Shader::GetVaryings;
+	m_Shader.selectRasterJobs = &Mesh3D::SelectRasterJobs<Shader>;
+	m_Shader.addVertexJobs = &Mesh3D::AddVertexJobs<Shader>;
+	m_Shader.pShader = std::move(pShader);
+
+	// Vertices of the previous shader are no use to this one
+	m_TransformKeys.assign(m_TransformKeys.size(), TransformKey{});
+}
+
+// Shaders meshes can be bound to, a new material adds its line here
+template void Mesh3D::SetSoftwareShader(std::shared_ptr<const VehicleShader> pShader);
+template void Mesh3D::SetSoftwareShader(std::shared_ptr<const FireShader> pShader);
@@ -8,12 +8,31 @@
 #include "DataTypes.h"
 #include "Camera.h"
 #include "Matrix.h"
+#include "Rasterizer.h"
+#include "HiZBuffer.h"
+#include "DepthBuffer.h"
+#include "JobSystem.h"
+#include "ColorBuffer.h"
+#include "SoftwareShader.h"
+#include <memory>
 using namespace dae;
 
+//Software shader and per-draw switches as compile-time constants, every variant gets its own rasterization
+template<typename ShaderType, DisplayMode displayMode, ShadingMode shadingMode, bool isNormalMap, ShadingPrecision precision>
+struct ShadingVariant
+{
+	using Shader = ShaderType;
+	static constexpr DisplayMode DISPLAY_MODE{ displayMode };
+	static constexpr ShadingMode SHADING_MODE{ shadingMode };
+	static constexpr bool IS_NORMAL_MAP{ isNormalMap };
+	static constexpr ShadingPrecision PRECISION{ precision };
+	static constexpr bool IS_TRANSPARENT{ Shader::IS_TRANSPARENT };
+};
+
 class Mesh3D final
 {
 public:
-	Mesh3D(ID3D11Device* pDevice, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Effect* pEffect, bool toApplyTransparency);
+	Mesh3D(ID3D11Device* pDevice, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Effect* pEffect);
 	~Mesh3D();
 
 	Mesh3D(const Mesh3D& other) = delete;
@@ -21,44 +40,41 @@ public:
 	Mesh3D(Mesh3D&& other) = delete;
 	Mesh3D& operator=(Mesh3D&& rhs) = delete;
 
+	//Binds the CPU counterpart of the effect, software vertex processing and rasterization are instantiated for its type.
+	//Every shader type a mesh can be bound to is listed at the end of Mesh3D.cpp
+	template<SoftwareShader Shader>
+	void SetSoftwareShader(std::shared_ptr<const Shader> pShader);
+
 	void RenderGPU(const Vector3& cameraPosition, const Matrix& pWorldMatrix, const Matrix& pWorldViewProjectionMatrix, ID3D11DeviceContext* pDeviceContext) const;
-	void RenderCPU(int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, bool isNormalMap, SDL_Surface* pBackBuffer, uint32_t* pBackBufferPixels, float* pDepthBufferPixels) const;
+	//Adds the software rendering of this mesh to the frame graph, returns the job that finishes it.
+	//Setup and binning start once vertexTransform finished (INVALID_JOB for an up to date frame slot),
+	//rasterization waits for the dependencies as well (earlier draws into the same targets).
+	//An occlusion tested mesh skips rasterization when the hierarchical Z-buffer already hides all of it.
+	//Tiles are cleared through clearState the first time this frame a triangle lands in them.
+	//Depth and visibility buffers are addressed through the pixel layout of the color buffer.
+	//With a depth pre-pass opaque forward shading first lays down depth per tile, then shades only the pixels that kept it.
+	//Fast shading precision swaps the shading math for the approximations of FastMath.h.
+	JobId RenderCPU(JobGraph& graph, JobId vertexTransform, const std::vector<JobId>& dependencies, int frameSlot, int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, bool isNormalMap, ColorBuffer& colorBuffer, DepthBuffer& depthBuffer, HiZBuffer& hiZBuffer, TileClearState& clearState, VisibilityBuffer* pVisibilityBuffer = nullptr, bool isOcclusionTested = false, bool isDepthPrepassed = false, ShadingPrecision shadingPrecision = ShadingPrecision::Exact);
+	//Screen rect and depth range of the transformed mesh, false when it can't be bounded (vertex behind the camera).
+	//Only merges the bounds the vertex transform batches stored in the frame slot
+	bool CalculateScreenBounds(int frameSlot, int width, int height, TileRect& bounds, float& minDepth, float& maxDepth) const;
 
 	void SetCullingMode(CullingMode cullingMode, ID3D11DeviceContext* context);
 
-	void VertexTransformationFunction(const Camera& camera, const Matrix& rotationMatrix);
-	ColorRGB PixelShading(Vertex_Out& v, ShadingMode shadingMode, bool isNormalMap, ColorRGB existingPixelColor = { 0.f, 0.f, 0.f}) const;
-
-	bool CheckClipping(const Vector4& v0, const Vector4& v1, const Vector4& v2) const;
+	//Every frame in flight transforms into its own slot, so the next update can't touch vertices still being rasterized
+	void SetFrameSlotCount(int count);
+	//A slot is only transformed again once the camera version or the rotation version differs from what it holds,
+	//INVALID_JOB is returned when it is still up to date
+	JobId VertexTransformationFunction(JobGraph& graph, int frameSlot, const Camera& camera, const Matrix& rotationMatrix, uint32_t rotationVersion);
 	void ConvertToScreenSpace(float width, float height, Vector4& v0, Vector4& v1, Vector4& v2) const;
 
-	inline float Remap(float value, float start1, float stop1, float start2, float stop2) const
+	//Works on plain floats and on shading lanes alike
+	template<typename Value>
+	inline Value Remap(const Value& value, float start1, float stop1, float start2, float stop2) const
 	{
 		return start2 + (value - start1) * (stop2 - start2) / (stop1 - start1);
 	}
 
-	//Materials formulas
-	static ColorRGB Lambert(const ColorRGB cd, const float kd = 1)
-	{
-		const ColorRGB rho = kd * cd;
-		return rho / PI;
-	}
-
-	static ColorRGB Lambert(const ColorRGB cd, const ColorRGB& kd)
-	{
-		const ColorRGB rho = kd * cd;
-		return rho / PI;
-	}
-
-	static ColorRGB Phong(const ColorRGB ks, const float exp, const Vector3& l, const Vector3& v, const Vector3& n)
-	{
-		const Vector3 reflect = l - (2 * std::max(Vector3::Dot(n, l), 0.f) * n);
-		const float cosAlpha = std::max(Vector3::Dot(reflect, v), 0.f);
-
-		return ks * std::powf(cosAlpha, exp);
-	}
-
-	
 private:
 	uint32_t				m_NumIndices{};
 	Effect*					m_pEffect;
@@ -68,5 +84,78 @@ private:
 	ID3D11Buffer*			m_pIndexBuffer{};
 
 	std::unique_ptr<Mesh>	m_pUMesh{};
-	bool m_ToApplyTransparency; 
+	//Software vertex stage input and its post-transform cache per frame slot, both structure-of-arrays
+	VertexStreams					m_VertexStreams{};
+	std::vector<VertexStreams_Out>	m_VerticesOut{};
+
+	//Versions the vertices of a frame slot were transformed with
+	struct TransformKey
+	{
+		bool isValid{};
+		uint32_t cameraVersion{};
+		uint32_t rotationVersion{};
+	};
+	std::vector<TransformKey>		m_TransformKeys{};
+
+	//NDC range of a batch of transformed vertices, unbounded once one of them lies behind the camera
+	struct VertexBounds
+	{
+		bool isBounded{};
+		float minX{}, minY{}, minZ{};
+		float maxX{}, maxY{}, maxZ{};
+	};
+	//Per frame slot, one entry per vertex transform batch
+	std::vector<std::vector<VertexBounds>>	m_VertexBounds{};
+	static VertexBounds CalculateVertexBounds(const Vector4Stream& positions, int first, int last);
+
+	//Software rasterizer state, reused every frame
+	int										m_NumBinningChunks{ 1 };
+	TileBinner								m_TileBinner{};
+	std::vector<std::vector<TriangleSetup>>	m_TriangleSetups{};
+	bool									m_IsOccluded{ false };
+
+	//Targets and state shared by the rasterization jobs of one draw
+	struct DrawState
+	{
+		int height{};
+		const PixelLayout* pLayout{};
+		ColorBuffer* pColorBuffer{};
+		DepthBuffer* pDepthBuffer{};
+		HiZBuffer* pHiZBuffer{};
+		TileClearState* pClearState{};
+		VisibilityBuffer* pVisibilityBuffer{};
+		const void* pShader{};
+		bool isPrepassed{};
+	};
+
+	//Rasterization (and deferred resolve) of one shading variant, picked from a table once per draw
+	using AddRasterJobsFunction = JobId(Mesh3D::*)(JobGraph& graph, const std::vector<JobId>& dependencies, const DrawState& draw);
+	template<typename Shader>
+	static AddRasterJobsFunction SelectRasterJobs(DisplayMode displayMode, ShadingMode shadingMode, bool isNormalMap, ShadingPrecision shadingPrecision);
+	template<typename Variant>
+	JobId AddRasterJobs(JobGraph& graph, const std::vector<JobId>& dependencies, const DrawState& draw);
+	using AddVertexJobsFunction = JobId(Mesh3D::*)(JobGraph& graph, int frameSlot, const VertexConstants& constants);
+	template<typename Shader>
+	JobId AddVertexJobs(JobGraph& graph, int frameSlot, const VertexConstants& constants);
+
+	//Everything the software path needs from the bound shader, the type itself only lives on in the instantiated functions
+	struct ShaderBinding
+	{
+		std::shared_ptr<const void> pShader{};
+		bool isTransparent{};
+		bool hasNormalMap{};
+		uint32_t(*getVaryings)(ShadingMode shadingMode, bool isNormalMap){};
+		AddRasterJobsFunction(*selectRasterJobs)(DisplayMode displayMode, ShadingMode shadingMode, bool isNormalMap, ShadingPrecision shadingPrecision){};
+		AddVertexJobsFunction addVertexJobs{};
+	};
+	ShaderBinding m_Shader{};
+
+	bool SetupTriangle(const Vertex_Out& vertex0, const Vertex_Out& vertex1, const Vertex_Out& vertex2, int width, int height, CullingMode cullingMode, uint32_t attributes, TriangleSetup& setup) const;
+	//Attributes the pixel shading of this display/shading mode actually reads
+	uint32_t GetRequiredAttributes(DisplayMode displayMode, ShadingMode shadingMode, bool isNormalMap) const;
+	template<typename Variant, RasterPass pass>
+	void RasterizeTriangle(const TriangleSetup& triangle, const TileRect& tile, const DrawState& draw, uint32_t triangleId) const;
+	//Shades the fragments of one triangle SHADING_LANES at a time and empties the batch
+	template<typename Variant>
+	void ShadeFragments(const TriangleSetup& triangle, FragmentBatch& batch, const DrawState& draw) const;
 };
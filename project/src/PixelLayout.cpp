@@ -0,0 +1,74 @@
+#include "pch.h"
+#include "PixelLayout.h"
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		constexpr size_t CACHE_LINE_SIZE{ 64 };
+	}
+
+	PixelLayout::PixelLayout(int width, int height, PixelLayoutType type) :
+		m_Type{ type },
+		m_Width{ width },
+		m_Height{ height }
+	{
+		if (type == PixelLayoutType::Linear)
+		{
+			m_PixelCount = width * height;
+			return;
+		}
+
+		const int blocksX = (width + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+		const int blocksY = (height + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+		m_BlockRowPitch = blocksX * PIXEL_BLOCK_SIZE * PIXEL_BLOCK_SIZE;
+		m_PixelCount = blocksY * m_BlockRowPitch;
+	}
+
+	PixelStorage::PixelStorage(size_t numBytes, bool isHugePageRequested)
+	{
+		numBytes = std::max(numBytes, CACHE_LINE_SIZE);
+
+#if defined(_WIN32)
+		const size_t largePageSize = isHugePageRequested ? GetLargePageMinimum() : 0;
+		if (largePageSize > 0)
+		{
+			const size_t largeBytes = (numBytes + largePageSize - 1) / largePageSize * largePageSize;
+			m_pData = VirtualAlloc(nullptr, largeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			m_IsHugePage = m_pData != nullptr;
+		}
+		if (m_pData == nullptr)
+		{
+			m_pData = _aligned_malloc(numBytes, CACHE_LINE_SIZE);
+		}
+#else
+		constexpr size_t hugePageSize{ size_t(2) << 20 };
+		const size_t alignment = isHugePageRequested && numBytes >= hugePageSize ? hugePageSize : CACHE_LINE_SIZE;
+		m_pData = std::aligned_alloc(alignment, (numBytes + alignment - 1) / alignment * alignment);
+#if defined(__linux__)
+		m_IsHugePage = m_pData != nullptr && alignment == hugePageSize && madvise(m_pData, numBytes, MADV_HUGEPAGE) == 0;
+#endif
+#endif
+
+		if (m_pData == nullptr) throw std::bad_alloc{};
+	}
+
+	PixelStorage::~PixelStorage()
+	{
+#if defined(_WIN32)
+		if (m_IsHugePage)
+		{
+			VirtualFree(m_pData, 0, MEM_RELEASE);
+		}
+		else
+		{
+			_aligned_free(m_pData);
+		}
+#else
+		std::free(m_pData);
+#endif
+	}
+}
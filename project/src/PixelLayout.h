@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace dae
+{
+	//Side of the square pixel blocks of a blocked layout, each block is stored as 64 consecutive pixels
+	constexpr int PIXEL_BLOCK_SIZE{ 8 };
+
+	enum class PixelLayoutType
+	{
+		Linear,			//row-major, what SDL surfaces use
+		Blocked8x8		//8x8 blocks row by row, blocks themselves in row-major order
+	};
+
+	//Maps screen pixels to indices into the color, depth and visibility buffers.
+	//Pixels of one row inside one block are always consecutive, the raster kernels rely on nothing more.
+	class PixelLayout final
+	{
+	public:
+		PixelLayout() = default;
+		PixelLayout(int width, int height, PixelLayoutType type);
+
+		PixelLayoutType GetType() const { return m_Type; }
+		bool IsLinear() const { return m_Type == PixelLayoutType::Linear; }
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		//Pixels to allocate, blocked layouts are padded to whole blocks
+		int GetPixelCount() const { return m_PixelCount; }
+
+		int GetIndex(int px, int py) const
+		{
+			if (m_Type == PixelLayoutType::Linear) return px + py * m_Width;
+
+			constexpr int blockShift{ 3 };
+			constexpr int blockMask{ PIXEL_BLOCK_SIZE - 1 };
+			return (py >> blockShift) * m_BlockRowPitch + ((px >> blockShift) << (2 * blockShift)) + ((py & blockMask) << blockShift) + (px & blockMask);
+		}
+
+		//Index where row py starts, py has to start a block row or be the height.
+		//Rows [firstRow, lastRow) then cover exactly the indices [GetRowStart(firstRow), GetRowStart(lastRow)).
+		int GetRowStart(int py) const
+		{
+			if (m_Type == PixelLayoutType::Linear) return py * m_Width;
+			return (py + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE * m_BlockRowPitch;
+		}
+
+		//Calls function(firstIndex, lastIndex) for runs of consecutive indices that together cover the rect.
+		//Block aligned rects come in whole block runs, which may include the padding past the screen edge.
+		template<typename RunFunction>
+		void ForEachRun(int minX, int minY, int maxX, int maxY, RunFunction&& function) const
+		{
+			const bool isBlockAligned = minX % PIXEL_BLOCK_SIZE == 0 && minY % PIXEL_BLOCK_SIZE == 0 &&
+				(maxX % PIXEL_BLOCK_SIZE == 0 || maxX == m_Width) && (maxY % PIXEL_BLOCK_SIZE == 0 || maxY == m_Height);
+			if (m_Type == PixelLayoutType::Linear || !isBlockAligned)
+			{
+				ForEachRowRun(minX, minY, maxX, maxY, function);
+				return;
+			}
+
+			constexpr int blockPixels{ PIXEL_BLOCK_SIZE * PIXEL_BLOCK_SIZE };
+			const int firstBlockX = minX / PIXEL_BLOCK_SIZE;
+			const int lastBlockX = (maxX + PIXEL_BLOCK_SIZE - 1) / PIXEL_BLOCK_SIZE;
+			for (int blockY = minY / PIXEL_BLOCK_SIZE; blockY * PIXEL_BLOCK_SIZE < maxY; ++blockY)
+			{
+				function(blockY * m_BlockRowPitch + firstBlockX * blockPixels, blockY * m_BlockRowPitch + lastBlockX * blockPixels);
+			}
+		}
+
+		//Same as ForEachRun, but the runs cover the rect exactly and come in screen order, left to right and top to bottom
+		template<typename RunFunction>
+		void ForEachRowRun(int minX, int minY, int maxX, int maxY, RunFunction&& function) const
+		{
+			for (int py = minY; py < maxY; ++py)
+			{
+				if (m_Type == PixelLayoutType::Linear)
+				{
+					function(minX + py * m_Width, maxX + py * m_Width);
+					continue;
+				}
+
+				for (int px = minX; px < maxX;)
+				{
+					const int runEnd = std::min((px / PIXEL_BLOCK_SIZE + 1) * PIXEL_BLOCK_SIZE, maxX);
+					const int firstIndex = GetIndex(px, py);
+					function(firstIndex, firstIndex + (runEnd - px));
+					px = runEnd;
+				}
+			}
+		}
+
+	private:
+		PixelLayoutType m_Type{ PixelLayoutType::Linear };
+		int m_Width{};
+		int m_Height{};
+		int m_BlockRowPitch{};		//pixels per row of blocks
+		int m_PixelCount{};
+	};
+
+	//64-byte aligned pixel memory, so rows of a block never straddle cache lines.
+	//Huge pages are only a request: Windows needs the lock pages privilege for them, Linux gets a transparent huge page hint.
+	class PixelStorage final
+	{
+	public:
+		PixelStorage(size_t numBytes, bool isHugePageRequested);
+		~PixelStorage();
+
+		PixelStorage(const PixelStorage& other) = delete;
+		PixelStorage& operator=(const PixelStorage& rhs) = delete;
+		PixelStorage(PixelStorage&& other) = delete;
+		PixelStorage& operator=(PixelStorage&& rhs) = delete;
+
+		template<typename T>
+		T* GetData() const { return static_cast<T*>(m_pData); }
+		bool IsHugePage() const { return m_IsHugePage; }
+
+	private:
+		void* m_pData{};
+		bool m_IsHugePage{};
+	};
+}
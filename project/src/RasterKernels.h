@@ -0,0 +1,548 @@
+#pragma once
+#include <bit>
+#include <type_traits>
+#include <immintrin.h>
+#include "Rasterizer.h"
+#include "DepthBuffer.h"
+#include "DataTypes.h"
+#include "SimdLevel.h"
+
+namespace dae
+{
+	//Edge values inside a rect of at most one tile: the value at the first pixel center is evaluated exactly in 64 bit,
+	//every pixel then only adds a small 32-bit offset (a * dx + b * dy) to it, which fits integer SIMD lanes
+	struct RectEdges
+	{
+		int32_t stepX[3]{};				//offset change per pixel to the right
+		int32_t stepY[3]{};				//offset change per row
+		int32_t threshold[3]{};			//inside when offset > threshold
+	};
+
+	inline RectEdges SetupRectEdges(const TriangleSetup& triangle, int minX, int minY)
+	{
+		//Offsets inside a tile stay well below 2^30 (guard band bounds a and b), so clamping the thresholds never changes a comparison
+		constexpr int64_t thresholdLimit{ int64_t(1) << 30 };
+
+		const int64_t centerX = int64_t(minX) * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+		const int64_t centerY = int64_t(minY) * SUBPIXEL_SCALE + SUBPIXEL_SCALE / 2;
+
+		RectEdges edges;
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			const int64_t cornerValue = triangle.edgeA[edge] * centerX + triangle.edgeB[edge] * centerY + triangle.edgeC[edge];
+
+			// Top-left fill rule folded into the threshold: E >= 0 on top-left edges, E > 0 otherwise
+			const int64_t topLeftBias = triangle.isTopLeft[edge] ? 1 : 0;
+			edges.threshold[edge] = int32_t(std::clamp(-cornerValue - topLeftBias, -thresholdLimit, thresholdLimit));
+
+			edges.stepX[edge] = triangle.edgeA[edge] * SUBPIXEL_SCALE;
+			edges.stepY[edge] = triangle.edgeB[edge] * SUBPIXEL_SCALE;
+		}
+		return edges;
+	}
+
+	//True when every pixel center of the rect is inside the triangle, checking the corners is enough since both are convex
+	inline bool IsCoveringBlock(const TriangleSetup& triangle, const TileRect& rect)
+	{
+		const RectEdges edges = SetupRectEdges(triangle, rect.minX, rect.minY);
+		const int lastX = rect.maxX - 1 - rect.minX;
+		const int lastY = rect.maxY - 1 - rect.minY;
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			const int32_t right = edges.stepX[edge] * lastX;
+			const int32_t bottom = edges.stepY[edge] * lastY;
+			if (0 <= edges.threshold[edge] || right <= edges.threshold[edge] || bottom <= edges.threshold[edge] || right + bottom <= edges.threshold[edge]) return false;
+		}
+		return true;
+	}
+
+	//Depth storage as the kernels see it: depth is turned into a key first, smaller keys are closer.
+	//Partial spans never touch pixels past numLanes, the neighbouring tile may belong to another job.
+
+	template<bool isReversed>
+	struct FloatDepthAccess
+	{
+		float* pKeys;
+
+		float ToKey(float depth) const { return isReversed ? -depth : depth; }
+		float LoadKey(int pixelIndex) const { return pKeys[pixelIndex]; }
+		void StoreKey(int pixelIndex, float key) const { pKeys[pixelIndex] = key; }
+
+		DAE_TARGET_SSE41 __m128 ToKeys4(__m128 depth) const { return isReversed ? _mm_xor_ps(depth, _mm_set1_ps(-0.f)) : depth; }
+		DAE_TARGET_SSE41 __m128 LoadKeys4(int pixelIndex, int numLanes) const
+		{
+			if (numLanes == 4) return _mm_loadu_ps(pKeys + pixelIndex);
+
+			alignas(16) float keys[4]{};
+			std::copy(pKeys + pixelIndex, pKeys + pixelIndex + numLanes, keys);
+			return _mm_load_ps(keys);
+		}
+		DAE_TARGET_SSE41 void StoreKeys4(int pixelIndex, __m128 keys, __m128 oldKeys, __m128 writeMask, int numLanes) const
+		{
+			alignas(16) float blended[4];
+			_mm_store_ps(blended, _mm_blendv_ps(oldKeys, keys, writeMask));
+			std::copy(blended, blended + numLanes, pKeys + pixelIndex);
+		}
+
+		DAE_TARGET_AVX2 __m256 ToKeys8(__m256 depth) const { return isReversed ? _mm256_xor_ps(depth, _mm256_set1_ps(-0.f)) : depth; }
+		DAE_TARGET_AVX2 __m256 LoadKeys8(int pixelIndex, __m256i laneMask, int) const { return _mm256_maskload_ps(pKeys + pixelIndex, laneMask); }
+		DAE_TARGET_AVX2 void StoreKeys8(int pixelIndex, __m256 keys, __m256, __m256 writeMask, int) const
+		{
+			_mm256_maskstore_ps(pKeys + pixelIndex, _mm256_castps_si256(writeMask), keys);
+		}
+	};
+
+	//Unorm24 lives in 32-bit words, Unorm16 in 16-bit ones. Keys are the integer values as floats, exact up to 2^24
+	template<typename T, bool isReversed>
+	struct UnormDepthAccess
+	{
+		static constexpr float SCALE{ sizeof(T) == sizeof(uint16_t) ? DepthBuffer::UNORM16_MAX : DepthBuffer::UNORM24_MAX };
+
+		T* pValues;
+
+		float ToKey(float depth) const { return float(uint32_t(std::clamp(isReversed ? 1.f - depth : depth, 0.f, 1.f) * SCALE + 0.5f)); }
+		float LoadKey(int pixelIndex) const { return float(pValues[pixelIndex]); }
+		void StoreKey(int pixelIndex, float key) const { pValues[pixelIndex] = T(key); }
+
+		DAE_TARGET_SSE41 __m128 ToKeys4(__m128 depth) const
+		{
+			const __m128 forwardDepth = isReversed ? _mm_sub_ps(_mm_set1_ps(1.f), depth) : depth;
+			return _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(forwardDepth, _mm_set1_ps(SCALE)), _mm_set1_ps(0.5f))));
+		}
+		DAE_TARGET_SSE41 __m128 LoadKeys4(int pixelIndex, int numLanes) const
+		{
+			if (numLanes == 4)
+			{
+				if constexpr (sizeof(T) == sizeof(uint16_t)) return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pValues + pixelIndex))));
+				else return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pValues + pixelIndex)));
+			}
+
+			alignas(16) float keys[4]{};
+			for (int lane = 0; lane < numLanes; ++lane)
+			{
+				keys[lane] = float(pValues[pixelIndex + lane]);
+			}
+			return _mm_load_ps(keys);
+		}
+		DAE_TARGET_SSE41 void StoreKeys4(int pixelIndex, __m128 keys, __m128 oldKeys, __m128 writeMask, int numLanes) const
+		{
+			const __m128i values = _mm_cvttps_epi32(_mm_blendv_ps(oldKeys, keys, writeMask));
+			if (numLanes == 4)
+			{
+				if constexpr (sizeof(T) == sizeof(uint16_t)) _mm_storel_epi64(reinterpret_cast<__m128i*>(pValues + pixelIndex), _mm_packus_epi32(values, values));
+				else _mm_storeu_si128(reinterpret_cast<__m128i*>(pValues + pixelIndex), values);
+				return;
+			}
+
+			alignas(16) int32_t stored[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(stored), values);
+			for (int lane = 0; lane < numLanes; ++lane)
+			{
+				pValues[pixelIndex + lane] = T(stored[lane]);
+			}
+		}
+
+		DAE_TARGET_AVX2 __m256 ToKeys8(__m256 depth) const
+		{
+			const __m256 forwardDepth = isReversed ? _mm256_sub_ps(_mm256_set1_ps(1.f), depth) : depth;
+			return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(forwardDepth, _mm256_set1_ps(SCALE)), _mm256_set1_ps(0.5f))));
+		}
+		DAE_TARGET_AVX2 __m256 LoadKeys8(int pixelIndex, __m256i laneMask, int numLanes) const
+		{
+			if constexpr (sizeof(T) != sizeof(uint16_t))
+			{
+				return _mm256_cvtepi32_ps(_mm256_maskload_epi32(reinterpret_cast<const int*>(pValues + pixelIndex), laneMask));
+			}
+			else
+			{
+				if (numLanes == 8) return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pValues + pixelIndex))));
+
+				alignas(32) float keys[8]{};
+				for (int lane = 0; lane < numLanes; ++lane)
+				{
+					keys[lane] = float(pValues[pixelIndex + lane]);
+				}
+				return _mm256_load_ps(keys);
+			}
+		}
+		DAE_TARGET_AVX2 void StoreKeys8(int pixelIndex, __m256 keys, __m256 oldKeys, __m256 writeMask, int numLanes) const
+		{
+			if constexpr (sizeof(T) != sizeof(uint16_t))
+			{
+				_mm256_maskstore_epi32(reinterpret_cast<int*>(pValues + pixelIndex), _mm256_castps_si256(writeMask), _mm256_cvttps_epi32(keys));
+			}
+			else
+			{
+				const __m256i values = _mm256_cvttps_epi32(_mm256_blendv_ps(oldKeys, keys, writeMask));
+				if (numLanes == 8)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(pValues + pixelIndex), _mm_packus_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1)));
+					return;
+				}
+
+				alignas(32) int32_t stored[8];
+				_mm256_store_si256(reinterpret_cast<__m256i*>(stored), values);
+				for (int lane = 0; lane < numLanes; ++lane)
+				{
+					pValues[pixelIndex + lane] = T(stored[lane]);
+				}
+			}
+		}
+	};
+
+	//Stands in for a compressed block the whole triangle is in front of: every pixel passes and nothing gets stored
+	struct UnboundedDepthAccess
+	{
+		float ToKey(float depth) const { return depth; }
+		float LoadKey(int) const { return std::numeric_limits<float>::max(); }
+		void StoreKey(int, float) const {}
+
+		DAE_TARGET_SSE41 __m128 ToKeys4(__m128 depth) const { return depth; }
+		DAE_TARGET_SSE41 __m128 LoadKeys4(int, int) const { return _mm_set1_ps(std::numeric_limits<float>::max()); }
+		DAE_TARGET_SSE41 void StoreKeys4(int, __m128, __m128, __m128, int) const {}
+
+		DAE_TARGET_AVX2 __m256 ToKeys8(__m256 depth) const { return depth; }
+		DAE_TARGET_AVX2 __m256 LoadKeys8(int, __m256i, int) const { return _mm256_set1_ps(std::numeric_limits<float>::max()); }
+		DAE_TARGET_AVX2 void StoreKeys8(int, __m256, __m256, __m256, int) const {}
+	};
+
+	//Calls function with the access matching the format of the depth buffer
+	template<typename Function>
+	void VisitDepthAccess(DepthBuffer& depthBuffer, Function&& function)
+	{
+		void* pData = depthBuffer.GetData();
+		const bool isReversed = depthBuffer.IsReversedZ();
+		switch (depthBuffer.GetFormat())
+		{
+		case DepthFormat::Unorm24:
+			if (isReversed) function(UnormDepthAccess<uint32_t, true>{ static_cast<uint32_t*>(pData) });
+			else function(UnormDepthAccess<uint32_t, false>{ static_cast<uint32_t*>(pData) });
+			break;
+		case DepthFormat::Unorm16:
+			if (isReversed) function(UnormDepthAccess<uint16_t, true>{ static_cast<uint16_t*>(pData) });
+			else function(UnormDepthAccess<uint16_t, false>{ static_cast<uint16_t*>(pData) });
+			break;
+		default:
+			if (isReversed) function(FloatDepthAccess<true>{ static_cast<float*>(pData) });
+			else function(FloatDepthAccess<false>{ static_cast<float*>(pData) });
+			break;
+		}
+	}
+
+	enum class DepthTest
+	{
+		Less,	//regular test, the first of several fragments at the same depth wins
+		Equal	//shading after a depth pre-pass, only fragments at the depth left there pass (ties all shade, the last one wins)
+	};
+
+	//Fragment function of depth-only passes, the kernels skip everything past the depth write for it
+	struct DepthOnlyFragment
+	{
+		void operator()(int, float, float, float) const {}
+	};
+
+	//Fragment function of deferred shading, records the triangle that won the depth test and its weights
+	struct VisibilityFragment
+	{
+		VisibilityBuffer* pVisibilityBuffer;
+		uint32_t triangleId;
+
+		void operator()(int pixelIndex, float weight0, float weight1, float) const
+		{
+			pVisibilityBuffer->triangleIds[pixelIndex] = triangleId;
+			pVisibilityBuffer->weights0[pixelIndex] = weight0;
+			pVisibilityBuffer->weights1[pixelIndex] = weight1;
+		}
+	};
+
+	template<typename FragmentFunc>
+	constexpr bool IS_DEPTH_ONLY{ std::is_same_v<std::remove_cvref_t<FragmentFunc>, DepthOnlyFragment> };
+
+	//The kernels below walk the part of a triangle inside a screen rect, one HiZ block of a tile.
+	//Rows of the rect must be consecutive in the pixel layout, so in a blocked layout the rect can't cross a pixel block.
+	//Culling already happened at setup and back faces arrive with flipped edges, so only one side is ever tested.
+	//Pixels that pass coverage and the depth test get their depth written (when writeDepth),
+	//then shadeFragment(pixelIndex, weight0, weight1, depth) is called for them.
+	//Returns whether any depth was written.
+
+	template<DepthTest depthTest, typename DepthAccess, typename FragmentFunc>
+	bool ScanTriangleScalar(const TriangleSetup& triangle, const TileRect& rect, const PixelLayout& layout, bool writeDepth, const DepthAccess& depthAccess, FragmentFunc&& shadeFragment)
+	{
+		const int minX = std::max(triangle.minX, rect.minX);
+		const int maxX = std::min(triangle.maxX, rect.maxX);
+		const int minY = std::max(triangle.minY, rect.minY);
+		const int maxY = std::min(triangle.maxY, rect.maxY);
+		bool isDepthWritten{ false };
+
+		const RectEdges edges = SetupRectEdges(triangle, minX, minY);
+		for (int py = minY; py < maxY; ++py)
+		{
+			int32_t offset0 = edges.stepY[0] * (py - minY);
+			int32_t offset1 = edges.stepY[1] * (py - minY);
+			int32_t offset2 = edges.stepY[2] * (py - minY);
+
+			const int rowIndex = layout.GetIndex(minX, py);
+			const float relativeY = (float(py) + 0.5f) - triangle.weightOriginY;
+			const float rowWeight0 = triangle.weightB[0] * relativeY;
+			const float rowWeight1 = triangle.weightB[1] * relativeY;
+
+			for (int px = minX; px < maxX; ++px, offset0 += edges.stepX[0], offset1 += edges.stepX[1], offset2 += edges.stepX[2])
+			{
+				if (offset0 <= edges.threshold[0] || offset1 <= edges.threshold[1] || offset2 <= edges.threshold[2]) continue;
+
+				const float relativeX = (float(px) + 0.5f) - triangle.weightOriginX;
+				const float weight0 = triangle.weightA[0] * relativeX + rowWeight0;
+				const float weight1 = triangle.weightA[1] * relativeX + rowWeight1;
+
+				const float zBufferValue = InterpolateDepth(triangle, weight0, weight1);
+				if (zBufferValue < 0 || zBufferValue > 1) continue;
+
+				const int pixelIndex = rowIndex + (px - minX);
+				const float depthKey = depthAccess.ToKey(zBufferValue);
+				const float oldKey = depthAccess.LoadKey(pixelIndex);
+				if (depthTest == DepthTest::Less ? depthKey >= oldKey : depthKey != oldKey) continue;
+
+				if (writeDepth)
+				{
+					depthAccess.StoreKey(pixelIndex, depthKey);
+					isDepthWritten = true;
+				}
+
+				if constexpr (!IS_DEPTH_ONLY<FragmentFunc>) shadeFragment(pixelIndex, weight0, weight1, zBufferValue);
+			}
+		}
+		return isDepthWritten;
+	}
+
+	template<DepthTest depthTest, typename DepthAccess, typename FragmentFunc>
+	DAE_TARGET_SSE41 bool ScanTriangleSSE41(const TriangleSetup& triangle, const TileRect& rect, const PixelLayout& layout, bool writeDepth, const DepthAccess& depthAccess, FragmentFunc&& shadeFragment)
+	{
+		constexpr int LANES{ 4 };
+
+		const int minX = std::max(triangle.minX, rect.minX);
+		const int maxX = std::min(triangle.maxX, rect.maxX);
+		const int minY = std::max(triangle.minY, rect.minY);
+		const int maxY = std::min(triangle.maxY, rect.maxY);
+		bool isDepthWritten{ false };
+
+		const RectEdges rectEdges = SetupRectEdges(triangle, minX, minY);
+
+		const __m128i laneIndices = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128i allLanes = _mm_set1_epi32(-1);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 weightA0 = _mm_set1_ps(triangle.weightA[0]);
+		const __m128 weightA1 = _mm_set1_ps(triangle.weightA[1]);
+		const __m128 weightOriginX = _mm_set1_ps(triangle.weightOriginX);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 invZ0 = _mm_set1_ps(triangle.invZ[0]);
+		const __m128 invZ1 = _mm_set1_ps(triangle.invZ[1]);
+		const __m128 invZ2 = _mm_set1_ps(triangle.invZ[2]);
+
+		__m128i laneOffsets[3];
+		__m128i spanStep[3];
+		__m128i threshold[3];
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			laneOffsets[edge] = _mm_mullo_epi32(laneIndices, _mm_set1_epi32(rectEdges.stepX[edge]));
+			spanStep[edge] = _mm_set1_epi32(rectEdges.stepX[edge] * LANES);
+			threshold[edge] = _mm_set1_epi32(rectEdges.threshold[edge]);
+		}
+
+		for (int py = minY; py < maxY; ++py)
+		{
+			__m128i offsets[3];
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				offsets[edge] = _mm_add_epi32(_mm_set1_epi32(rectEdges.stepY[edge] * (py - minY)), laneOffsets[edge]);
+			}
+
+			const int rowIndex = layout.GetIndex(minX, py);
+			const float relativeY = (float(py) + 0.5f) - triangle.weightOriginY;
+			const __m128 rowWeight0 = _mm_set1_ps(triangle.weightB[0] * relativeY);
+			const __m128 rowWeight1 = _mm_set1_ps(triangle.weightB[1] * relativeY);
+
+			for (int px = minX; px < maxX; px += LANES)
+			{
+				const int pixelIndex = rowIndex + (px - minX);
+				const int numLanes = std::min(LANES, maxX - px);
+				const __m128i laneMask = numLanes == LANES ? allLanes : _mm_cmpgt_epi32(_mm_set1_epi32(numLanes), laneIndices);
+
+				// Exact integer coverage per lane
+				__m128i coverage = laneMask;
+				for (int edge = 0; edge < 3; ++edge)
+				{
+					coverage = _mm_and_si128(coverage, _mm_cmpgt_epi32(offsets[edge], threshold[edge]));
+				}
+				__m128 mask = _mm_castsi128_ps(coverage);
+
+				if (_mm_movemask_ps(mask) != 0)
+				{
+					const __m128 relativeX = _mm_sub_ps(_mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(px), laneIndices)), half), weightOriginX);
+					const __m128 weight0 = _mm_add_ps(_mm_mul_ps(weightA0, relativeX), rowWeight0);
+					const __m128 weight1 = _mm_add_ps(_mm_mul_ps(weightA1, relativeX), rowWeight1);
+					const __m128 weight2 = _mm_sub_ps(_mm_sub_ps(one, weight0), weight1);
+					const __m128 invZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weight0, invZ0), _mm_mul_ps(weight1, invZ1)), _mm_mul_ps(weight2, invZ2));
+					const __m128 zBufferValue = _mm_div_ps(one, invZ);
+
+					const __m128 depthKeys = depthAccess.ToKeys4(zBufferValue);
+					const __m128 oldKeys = depthAccess.LoadKeys4(pixelIndex, numLanes);
+
+					mask = _mm_and_ps(mask, _mm_cmpge_ps(zBufferValue, zero));
+					mask = _mm_and_ps(mask, _mm_cmple_ps(zBufferValue, one));
+					mask = _mm_and_ps(mask, depthTest == DepthTest::Less ? _mm_cmplt_ps(depthKeys, oldKeys) : _mm_cmpeq_ps(depthKeys, oldKeys));
+
+					int laneBits = _mm_movemask_ps(mask);
+					if (laneBits != 0)
+					{
+						// Lane mask drives the depth write
+						if (writeDepth)
+						{
+							depthAccess.StoreKeys4(pixelIndex, depthKeys, oldKeys, mask, numLanes);
+							isDepthWritten = true;
+						}
+
+						if constexpr (!IS_DEPTH_ONLY<FragmentFunc>)
+						{
+							alignas(16) float weights0[LANES];
+							alignas(16) float weights1[LANES];
+							alignas(16) float depths[LANES];
+							_mm_store_ps(weights0, weight0);
+							_mm_store_ps(weights1, weight1);
+							_mm_store_ps(depths, zBufferValue);
+
+							while (laneBits != 0)
+							{
+								const int lane = std::countr_zero(unsigned(laneBits));
+								shadeFragment(pixelIndex + lane, weights0[lane], weights1[lane], depths[lane]);
+								laneBits &= laneBits - 1;
+							}
+						}
+					}
+				}
+
+				for (int edge = 0; edge < 3; ++edge)
+				{
+					offsets[edge] = _mm_add_epi32(offsets[edge], spanStep[edge]);
+				}
+			}
+		}
+		return isDepthWritten;
+	}
+
+	template<DepthTest depthTest, typename DepthAccess, typename FragmentFunc>
+	DAE_TARGET_AVX2 bool ScanTriangleAVX2(const TriangleSetup& triangle, const TileRect& rect, const PixelLayout& layout, bool writeDepth, const DepthAccess& depthAccess, FragmentFunc&& shadeFragment)
+	{
+		constexpr int LANES{ 8 };
+
+		const int minX = std::max(triangle.minX, rect.minX);
+		const int maxX = std::min(triangle.maxX, rect.maxX);
+		const int minY = std::max(triangle.minY, rect.minY);
+		const int maxY = std::min(triangle.maxY, rect.maxY);
+		bool isDepthWritten{ false };
+
+		const RectEdges rectEdges = SetupRectEdges(triangle, minX, minY);
+
+		const __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256i allLanes = _mm256_set1_epi32(-1);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 weightA0 = _mm256_set1_ps(triangle.weightA[0]);
+		const __m256 weightA1 = _mm256_set1_ps(triangle.weightA[1]);
+		const __m256 weightOriginX = _mm256_set1_ps(triangle.weightOriginX);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 invZ0 = _mm256_set1_ps(triangle.invZ[0]);
+		const __m256 invZ1 = _mm256_set1_ps(triangle.invZ[1]);
+		const __m256 invZ2 = _mm256_set1_ps(triangle.invZ[2]);
+
+		__m256i laneOffsets[3];
+		__m256i spanStep[3];
+		__m256i threshold[3];
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			laneOffsets[edge] = _mm256_mullo_epi32(laneIndices, _mm256_set1_epi32(rectEdges.stepX[edge]));
+			spanStep[edge] = _mm256_set1_epi32(rectEdges.stepX[edge] * LANES);
+			threshold[edge] = _mm256_set1_epi32(rectEdges.threshold[edge]);
+		}
+
+		for (int py = minY; py < maxY; ++py)
+		{
+			__m256i offsets[3];
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				offsets[edge] = _mm256_add_epi32(_mm256_set1_epi32(rectEdges.stepY[edge] * (py - minY)), laneOffsets[edge]);
+			}
+
+			const int rowIndex = layout.GetIndex(minX, py);
+			const float relativeY = (float(py) + 0.5f) - triangle.weightOriginY;
+			const __m256 rowWeight0 = _mm256_set1_ps(triangle.weightB[0] * relativeY);
+			const __m256 rowWeight1 = _mm256_set1_ps(triangle.weightB[1] * relativeY);
+
+			for (int px = minX; px < maxX; px += LANES)
+			{
+				const int pixelIndex = rowIndex + (px - minX);
+				const int numLanes = std::min(LANES, maxX - px);
+				const __m256i laneMask = numLanes == LANES ? allLanes : _mm256_cmpgt_epi32(_mm256_set1_epi32(numLanes), laneIndices);
+
+				// Exact integer coverage per lane
+				__m256i coverage = laneMask;
+				for (int edge = 0; edge < 3; ++edge)
+				{
+					coverage = _mm256_and_si256(coverage, _mm256_cmpgt_epi32(offsets[edge], threshold[edge]));
+				}
+				__m256 mask = _mm256_castsi256_ps(coverage);
+
+				if (_mm256_movemask_ps(mask) != 0)
+				{
+					const __m256 relativeX = _mm256_sub_ps(_mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(px), laneIndices)), half), weightOriginX);
+					const __m256 weight0 = _mm256_add_ps(_mm256_mul_ps(weightA0, relativeX), rowWeight0);
+					const __m256 weight1 = _mm256_add_ps(_mm256_mul_ps(weightA1, relativeX), rowWeight1);
+					const __m256 weight2 = _mm256_sub_ps(_mm256_sub_ps(one, weight0), weight1);
+					const __m256 invZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(weight0, invZ0), _mm256_mul_ps(weight1, invZ1)), _mm256_mul_ps(weight2, invZ2));
+					const __m256 zBufferValue = _mm256_div_ps(one, invZ);
+
+					const __m256 depthKeys = depthAccess.ToKeys8(zBufferValue);
+					const __m256 oldKeys = depthAccess.LoadKeys8(pixelIndex, laneMask, numLanes);
+
+					mask = _mm256_and_ps(mask, _mm256_cmp_ps(zBufferValue, zero, _CMP_GE_OQ));
+					mask = _mm256_and_ps(mask, _mm256_cmp_ps(zBufferValue, one, _CMP_LE_OQ));
+					mask = _mm256_and_ps(mask, _mm256_cmp_ps(depthKeys, oldKeys, depthTest == DepthTest::Less ? _CMP_LT_OQ : _CMP_EQ_OQ));
+
+					int laneBits = _mm256_movemask_ps(mask);
+					if (laneBits != 0)
+					{
+						// Lane mask drives the depth write
+						if (writeDepth)
+						{
+							depthAccess.StoreKeys8(pixelIndex, depthKeys, oldKeys, mask, numLanes);
+							isDepthWritten = true;
+						}
+
+						if constexpr (!IS_DEPTH_ONLY<FragmentFunc>)
+						{
+							alignas(32) float weights0[LANES];
+							alignas(32) float weights1[LANES];
+							alignas(32) float depths[LANES];
+							_mm256_store_ps(weights0, weight0);
+							_mm256_store_ps(weights1, weight1);
+							_mm256_store_ps(depths, zBufferValue);
+
+							while (laneBits != 0)
+							{
+								const int lane = std::countr_zero(unsigned(laneBits));
+								shadeFragment(pixelIndex + lane, weights0[lane], weights1[lane], depths[lane]);
+								laneBits &= laneBits - 1;
+							}
+						}
+					}
+				}
+
+				for (int edge = 0; edge < 3; ++edge)
+				{
+					offsets[edge] = _mm256_add_epi32(offsets[edge], spanStep[edge]);
+				}
+			}
+		}
+		return isDepthWritten;
+	}
+}
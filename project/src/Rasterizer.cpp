@@ -0,0 +1,138 @@
+#include "pch.h"
+#include "Rasterizer.h"
+#include "RasterKernels.h"
+#include "DepthBuffer.h"
+
+namespace dae
+{
+	SimdLevel GetSimdLevel()
+	{
+		static const SimdLevel simdLevel{ SDL_HasAVX2() ? SimdLevel::AVX2 : SDL_HasSSE41() ? SimdLevel::SSE41 : SimdLevel::Scalar };
+		return simdLevel;
+	}
+
+	void SetupAttributePlanes(TriangleSetup& triangle, const Vertex_Out& vertex0, const Vertex_Out& vertex1, const Vertex_Out& vertex2, uint32_t attributes)
+	{
+		const float invW0 = 1.f / triangle.v0.w;
+		const float invW1 = 1.f / triangle.v1.w;
+		const float invW2 = 1.f / triangle.v2.w;
+
+		triangle.attributes = attributes;
+		triangle.invW.Setup(invW0, invW1, invW2);
+
+		if (attributes & AttributeUV)
+		{
+			triangle.uv[0].Setup(vertex0.uv.x * invW0, vertex1.uv.x * invW1, vertex2.uv.x * invW2);
+			triangle.uv[1].Setup(vertex0.uv.y * invW0, vertex1.uv.y * invW1, vertex2.uv.y * invW2);
+		}
+
+		const auto setupDirection = [&](AttributePlane* pPlanes, const Vector3& direction0, const Vector3& direction1, const Vector3& direction2)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				pPlanes[axis].Setup(direction0[axis] * invW0, direction1[axis] * invW1, direction2[axis] * invW2);
+			}
+		};
+
+		if (attributes & AttributeNormal)
+		{
+			setupDirection(triangle.normal, vertex0.normal, vertex1.normal, vertex2.normal);
+		}
+		if (attributes & AttributeTangent)
+		{
+			setupDirection(triangle.tangent, vertex0.tangent, vertex1.tangent, vertex2.tangent);
+		}
+		if (attributes & AttributeViewDirection)
+		{
+			setupDirection(triangle.viewDirection, vertex0.viewDirection, vertex1.viewDirection, vertex2.viewDirection);
+		}
+	}
+
+	void TileBinner::Resize(int width, int height)
+	{
+		if (width == m_Width && height == m_Height) return;
+
+		m_Width = width;
+		m_Height = height;
+		m_TilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		m_TilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+		m_Bins.clear();
+		m_NumChunks = 0;
+	}
+
+	void TileBinner::Reset(int numChunks)
+	{
+		const size_t numBins = size_t(numChunks) * GetTileCount();
+		if (m_Bins.size() != numBins)
+		{
+			m_Bins.resize(numBins);
+		}
+		m_NumChunks = numChunks;
+
+		//Keep the capacity, bins get refilled every frame
+		for (auto& bin : m_Bins)
+		{
+			bin.clear();
+		}
+	}
+
+	void TileBinner::Bin(int chunk, uint32_t triangleIndex, const TriangleSetup& triangle)
+	{
+		if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY) return;
+
+		const int minTileX = triangle.minX / TILE_SIZE;
+		const int minTileY = triangle.minY / TILE_SIZE;
+		const int maxTileX = (triangle.maxX - 1) / TILE_SIZE;
+		const int maxTileY = (triangle.maxY - 1) / TILE_SIZE;
+
+		std::vector<uint32_t>* pChunkBins = &m_Bins[size_t(chunk) * GetTileCount()];
+		for (int tileY = minTileY; tileY <= maxTileY; ++tileY)
+		{
+			for (int tileX = minTileX; tileX <= maxTileX; ++tileX)
+			{
+				pChunkBins[tileX + tileY * m_TilesX].push_back(triangleIndex);
+			}
+		}
+	}
+
+	TileRect TileBinner::GetTileRect(int tileIndex) const
+	{
+		const int tileX = tileIndex % m_TilesX;
+		const int tileY = tileIndex / m_TilesX;
+
+		TileRect rect;
+		rect.minX = tileX * TILE_SIZE;
+		rect.minY = tileY * TILE_SIZE;
+		rect.maxX = std::min(rect.minX + TILE_SIZE, m_Width);
+		rect.maxY = std::min(rect.minY + TILE_SIZE, m_Height);
+		return rect;
+	}
+
+	void TileClearState::Reset(int width, int height, const ColorRGB& clearColor)
+	{
+		m_Width = width;
+		m_TilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		m_ClearColor = clearColor;
+
+		const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+		m_IsCleared.assign(size_t(m_TilesX) * tilesY, 0);
+	}
+
+	void TileClearState::ClearOnFirstTouch(int tileIndex, const TileRect& tile, ColorBuffer& colorBuffer, DepthBuffer& depthBuffer)
+	{
+		if (m_IsCleared[tileIndex]) return;
+		m_IsCleared[tileIndex] = 1;
+
+		depthBuffer.ClearRect(tile);
+		colorBuffer.GetLayout().ForEachRun(tile.minX, tile.minY, tile.maxX, tile.maxY, [&](int firstIndex, int lastIndex)
+		{
+			colorBuffer.Fill(firstIndex, lastIndex, m_ClearColor);
+		});
+	}
+
+	const std::vector<uint32_t>& TileBinner::GetBin(int chunk, int tileIndex) const
+	{
+		return m_Bins[size_t(chunk) * GetTileCount() + tileIndex];
+	}
+}
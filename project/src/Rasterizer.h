@@ -0,0 +1,260 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include "Math.h"
+#include "DataTypes.h"
+#include "ColorBuffer.h"
+#include "FastMath.h"
+
+namespace dae
+{
+	class DepthBuffer;
+
+	//Screen positions are snapped to 28.4 fixed point before the edge functions are built
+	constexpr int SUBPIXEL_BITS{ 4 };
+	constexpr int SUBPIXEL_SCALE{ 1 << SUBPIXEL_BITS };
+
+	//Screen is split in square tiles, every tile is rasterized by exactly one worker
+	constexpr int TILE_SIZE{ 64 };
+
+	struct TileRect
+	{
+		int minX{};
+		int minY{};
+		int maxX{}; //exclusive
+		int maxY{}; //exclusive
+	};
+
+	//Triangle ids pack the binning chunk above the index of the setup inside that chunk
+	constexpr uint32_t TRIANGLE_INDEX_BITS{ 24 };
+	constexpr uint32_t TRIANGLE_INDEX_MASK{ (1u << TRIANGLE_INDEX_BITS) - 1 };
+	constexpr int MAX_BINNING_CHUNKS{ 255 };
+	constexpr uint32_t INVALID_TRIANGLE_ID{ 0xFFFFFFFF };
+
+	inline uint32_t PackTriangleId(int chunk, uint32_t triangleIndex)
+	{
+		return (uint32_t(chunk) << TRIANGLE_INDEX_BITS) | triangleIndex;
+	}
+
+	//Deferred shading input: the triangle that won the depth test per pixel and the weights inside it.
+	//A mesh resolves and empties it again before the next mesh renders.
+	struct VisibilityBuffer
+	{
+		std::vector<uint32_t> triangleIds{};
+		std::vector<float> weights0{};
+		std::vector<float> weights1{};
+
+		//Sized like the color and depth buffers of the same pixel layout
+		void Resize(const PixelLayout& layout)
+		{
+			const size_t numPixels = size_t(layout.GetPixelCount());
+			triangleIds.assign(numPixels, INVALID_TRIANGLE_ID);
+			weights0.assign(numPixels, 0.f);
+			weights1.assign(numPixels, 0.f);
+		}
+	};
+
+	//What a rasterization walk over the bins of a tile does with the pixels of a triangle
+	enum class RasterPass
+	{
+		Combined,	//depth test, depth write and shading in one go
+		DepthOnly,	//pre-pass, nothing but depth is written
+		Shading		//after the pre-pass, shades the pixels whose depth matches exactly
+	};
+
+	//Pass as a type, so generic lambdas can hand it on as a template argument
+	template<RasterPass pass>
+	using RasterPassTag = std::integral_constant<RasterPass, pass>;
+
+	//Vertex attributes a shading path reads, only these get plane equations and are interpolated
+	enum VertexAttributeFlags : uint32_t
+	{
+		AttributeNone = 0,
+		AttributeUV = 1 << 0,
+		AttributeNormal = 1 << 1,
+		AttributeTangent = 1 << 2,
+		AttributeViewDirection = 1 << 3
+	};
+
+	//Value that is affine in screen space, expressed in the barycentric weights of vertex 0 and 1
+	struct AttributePlane
+	{
+		float base{};
+		float weight0{};
+		float weight1{};
+
+		void Setup(float value0, float value1, float value2)
+		{
+			base = value2;
+			weight0 = value0 - value2;
+			weight1 = value1 - value2;
+		}
+
+		float Evaluate(float w0, float w1) const
+		{
+			return base + weight0 * w0 + weight1 * w1;
+		}
+	};
+
+	struct TriangleSetup
+	{
+		//Screen space positions (z = ndc depth, w = view depth)
+		Vector4 v0{};
+		Vector4 v1{};
+		Vector4 v2{};
+
+		//Integer edge functions E(x, y) = a * x + b * y + c on snapped sub-pixel coordinates, edge i is the one opposite to vertex i
+		int32_t edgeA[3]{};
+		int32_t edgeB[3]{};
+		int64_t edgeC[3]{};
+		bool isTopLeft[3]{};
+
+		//Barycentric weights of vertex 0 and 1 come from the unsnapped positions, snapping would tilt the depth plane
+		//of coplanar decals against the surface below them. Both are 0 at vertex 2: w(x, y) = a * (x - x2) + b * (y - y2)
+		float weightA[2]{};
+		float weightB[2]{};
+		float weightOriginX{};
+		float weightOriginY{};
+
+		//1 / ndc depth per vertex, depth is interpolated as its reciprocal
+		float invZ[3]{};
+		//Depth range of the vertices, the depth of every pixel lies inside it
+		float minDepth{};
+		float maxDepth{};
+
+		//Perspective-correct interpolation: attribute / w and 1 / w are affine in screen space
+		uint32_t attributes{};
+		AttributePlane invW{};
+		AttributePlane uv[2]{};
+		AttributePlane normal[3]{};
+		AttributePlane tangent[3]{};
+		AttributePlane viewDirection[3]{};
+
+		//Screen space bounding box, clamped to the viewport (max exclusive)
+		int minX{};
+		int minY{};
+		int maxX{};
+		int maxY{};
+	};
+
+	//Builds the planes of the requested attributes, vertices are the ones the setup positions came from
+	void SetupAttributePlanes(TriangleSetup& triangle, const Vertex_Out& vertex0, const Vertex_Out& vertex1, const Vertex_Out& vertex2, uint32_t attributes);
+
+	//Depth buffer value of a pixel from the weights of vertex 0 and 1, bit for bit what the raster kernels compute.
+	//Deriving the last weight keeps their sum at exactly 1
+	inline float InterpolateDepth(const TriangleSetup& triangle, float weight0, float weight1)
+	{
+		const float weight2 = 1.f - weight0 - weight1;
+		return 1.f / (weight0 * triangle.invZ[0] + weight1 * triangle.invZ[1] + weight2 * triangle.invZ[2]);
+	}
+
+	//Fills the requested attributes of SHADING_LANES pixels from the weights of vertex 0 and 1, returns the view depths
+	template<ShadingPrecision precision>
+	FloatLanes InterpolateAttributes(const TriangleSetup& triangle, const FloatLanes& weight0, const FloatLanes& weight1, VaryingLanes& varyings)
+	{
+		using Math = ShadingMath<precision>;
+		const auto evaluate = [&](const AttributePlane& plane) { return plane.base + plane.weight0 * weight0 + plane.weight1 * weight1; };
+		const FloatLanes viewDepth = Math::Reciprocal(evaluate(triangle.invW));
+
+		if (triangle.attributes & AttributeUV)
+		{
+			varyings.uv.x = evaluate(triangle.uv[0]) * viewDepth;
+			varyings.uv.y = evaluate(triangle.uv[1]) * viewDepth;
+		}
+
+		//Directions get normalized, so the multiplication with the view depth cancels out
+		if (triangle.attributes & AttributeNormal)
+		{
+			varyings.normal = Math::Normalized(Vector3Lanes{ evaluate(triangle.normal[0]), evaluate(triangle.normal[1]), evaluate(triangle.normal[2]) });
+		}
+		if (triangle.attributes & AttributeTangent)
+		{
+			varyings.tangent = Math::Normalized(Vector3Lanes{ evaluate(triangle.tangent[0]), evaluate(triangle.tangent[1]), evaluate(triangle.tangent[2]) });
+		}
+		if (triangle.attributes & AttributeViewDirection)
+		{
+			varyings.viewDirection = Math::Normalized(Vector3Lanes{ evaluate(triangle.viewDirection[0]), evaluate(triangle.viewDirection[1]), evaluate(triangle.viewDirection[2]) });
+		}
+
+		return viewDepth;
+	}
+
+	class TileBinner final
+	{
+	public:
+		TileBinner() = default;
+		~TileBinner() = default;
+
+		TileBinner(const TileBinner& other) = delete;
+		TileBinner& operator=(const TileBinner& rhs) = delete;
+		TileBinner(TileBinner&& other) = delete;
+		TileBinner& operator=(TileBinner&& rhs) = delete;
+
+		//Rebuilds the tile grid when the viewport size changed
+		void Resize(int width, int height);
+
+		//Empties all bins, every chunk of triangles gets its own set of bins so binning needs no locks
+		void Reset(int numChunks);
+		void Bin(int chunk, uint32_t triangleIndex, const TriangleSetup& triangle);
+
+		int GetTileCount() const { return m_TilesX * m_TilesY; }
+		int GetChunkCount() const { return m_NumChunks; }
+		TileRect GetTileRect(int tileIndex) const;
+		const std::vector<uint32_t>& GetBin(int chunk, int tileIndex) const;
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_TilesX{};
+		int m_TilesY{};
+		int m_NumChunks{};
+
+		//Triangle indices per [chunk * tileCount + tile], in submission order
+		std::vector<std::vector<uint32_t>> m_Bins{};
+	};
+
+	//Which tiles of the color and depth targets hold this frame's clear values.
+	//A tile is only cleared once something draws into it, the present pass writes the clear color for the untouched ones.
+	class TileClearState final
+	{
+	public:
+		TileClearState() = default;
+		~TileClearState() = default;
+
+		TileClearState(const TileClearState& other) = delete;
+		TileClearState& operator=(const TileClearState& rhs) = delete;
+		TileClearState(TileClearState&& other) = delete;
+		TileClearState& operator=(TileClearState&& rhs) = delete;
+
+		//Starts a new frame with every tile still holding the previous one
+		void Reset(int width, int height, const ColorRGB& clearColor);
+		//Clears color and depth of the tile the first time it gets touched this frame, only the job owning the tile may call this
+		void ClearOnFirstTouch(int tileIndex, const TileRect& tile, ColorBuffer& colorBuffer, DepthBuffer& depthBuffer);
+
+		const ColorRGB& GetClearColor() const { return m_ClearColor; }
+
+		//Splits row py at the tile borders and calls function(firstPixel, lastPixel, isCleared) per span of the tiles
+		//overlapping the columns of region, in linear pixel indices
+		template<typename SpanFunction>
+		void ForEachRowSpan(int py, const TileRect& region, SpanFunction&& function) const
+		{
+			const uint8_t* pIsCleared = &m_IsCleared[size_t(py / TILE_SIZE) * m_TilesX];
+			const int rowStart = py * m_Width;
+			for (int tileX = region.minX / TILE_SIZE; tileX * TILE_SIZE < region.maxX; ++tileX)
+			{
+				const int minX = tileX * TILE_SIZE;
+				const int maxX = std::min(minX + TILE_SIZE, m_Width);
+				function(rowStart + minX, rowStart + maxX, pIsCleared[tileX] != 0);
+			}
+		}
+
+	private:
+		int m_Width{};
+		int m_TilesX{};
+		ColorRGB m_ClearColor{};
+
+		//One byte per tile, so jobs owning neighbouring tiles never share a flag
+		std::vector<uint8_t> m_IsCleared{};
+	};
+}
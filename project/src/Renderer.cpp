@@ -2,16 +2,65 @@
 #include "Renderer.h"
 #include "Mesh3D.h"
 #include "Utils.h"
+#include "VehicleShader.h"
+#include "FireShader.h"
+#include <cassert>
 
 const std::string MAGENTA = "\033[35m";
 const std::string YELLOW = "\033[33m";
 const std::string GREEN = "\033[32m";
 const std::string RESET = "\033[0m";
 //extern ID3D11Debug* d3d11Debug;
+namespace
+{
+	// FNV-1a style, one step per value
+	void CombineHash(uint64_t& hash, uint64_t value)
+	{
+		hash = (hash ^ value) * 1099511628211ull;
+	}
+
+	dae::TileRect UnionRect(const dae::TileRect& a, const dae::TileRect& b)
+	{
+		return { std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY) };
+	}
+
+	// Grows the rect to whole tiles, so the present passes work on the same spans the clear state tracks
+	dae::TileRect AlignToTiles(const dae::TileRect& rect, int width, int height)
+	{
+		using dae::TILE_SIZE;
+		return { rect.minX / TILE_SIZE * TILE_SIZE, rect.minY / TILE_SIZE * TILE_SIZE,
+			std::min((rect.maxX + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE, width), std::min((rect.maxY + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE, height) };
+	}
+}
+
 namespace dae {
 
-	Renderer::Renderer(SDL_Window* pWindow) :
-		m_pWindow(pWindow)
+	uint64_t FrameSnapshot::GetViewHash() const
+	{
+		uint64_t hash{ 14695981039346656037ull };
+		const auto combine = [&hash](uint64_t value) { CombineHash(hash, value); };
+
+		combine(camera.version);
+		combine(uint64_t(shadingMode));
+		combine(uint64_t(displayMode));
+		combine(uint64_t(cullingMode));
+		combine(uint64_t(shadingPrecision));
+		combine(uint64_t(isNormalMap) | uint64_t(toRenderFireMesh) << 1 | uint64_t(isDeferredShading) << 2 | uint64_t(isDepthPrepass) << 3 | uint64_t(isClearColorUniform) << 4);
+		return hash;
+	}
+
+	uint64_t FrameSnapshot::GetStateHash() const
+	{
+		uint64_t hash{ GetViewHash() };
+		CombineHash(hash, worldMatrixVersion);
+		return hash;
+	}
+
+	Renderer::Renderer(SDL_Window* pWindow, const SoftwareConfig& config) :
+		m_pWindow(pWindow),
+		m_pJobSystem(std::make_unique<JobSystem>(config.numThreads, config.isAffinityPinned)),
+		m_pUpdateGraph(std::make_unique<JobGraph>()),
+		m_pFrameGraph(std::make_unique<JobGraph>())
 	{
 		//Initialize
 		SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
@@ -24,10 +73,20 @@ namespace dae {
 
 			// Create Buffers
 			m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-			m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
+			m_pBackBuffer = SDL_CreateRGBSurfaceWithFormat(0, m_Width, m_Height, 32, SDL_PIXELFORMAT_ARGB8888);
 			m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
-			m_pDepthBufferPixels = new float[m_Width * m_Height];
+			// ARGB8888 is BGRA8 in memory, a linear BGRA8 color buffer renders into the window surface (or else the back buffer) directly
+			m_PresentMode = SelectPresentMode();
+			uint32_t* pRenderTarget = m_PresentMode == PresentMode::Direct ? static_cast<uint32_t*>(m_pFrontBuffer->pixels) : m_pBackBufferPixels;
+			const PixelLayout pixelLayout{ m_Width, m_Height, config.pixelLayout };
+			m_pColorBuffer = std::make_unique<ColorBuffer>(pixelLayout, config.colorFormat, pRenderTarget, config.isHugePageRequested);
+
+			m_pDepthBuffer = std::make_unique<DepthBuffer>(pixelLayout, config.depthFormat, config.isReversedZ, config.isDepthPlaneCompressed, config.isHugePageRequested);
+			m_pHiZBuffer = std::make_unique<HiZBuffer>(m_Width, m_Height);
+			m_pVisibilityBuffer = std::make_unique<VisibilityBuffer>();
+			m_pVisibilityBuffer->Resize(pixelLayout);
+			m_pTileClearState = std::make_unique<TileClearState>();
 
 			m_pVehicleEffect = std::make_unique<VehicleEffect>(m_pDevice, L"resources/PosCol3D.fx");
 			InitializeVehicle();
@@ -36,12 +95,23 @@ namespace dae {
 			InitializeFire();
 
 			m_pCamera = std::make_unique<Camera>(Vector3{ 0.f, 0.f , -50.f }, 45.f, float(m_Width), float(m_Height));
+
+			// The render stage may run on its own thread, it only writes pixels. Every SDL call stays on this thread, in PresentCPU
+			assert(!SDL_MUSTLOCK(m_pBackBuffer) && !SDL_MUSTLOCK(m_pFrontBuffer));
+			m_pFramePipeline = std::make_unique<FramePipeline>(config.pipelineDepth,
+				[this](int frameSlot) { RenderCPU(m_FrameSnapshots[frameSlot], frameSlot); },
+				[this](int) { PresentCPU(); });
+			m_FrameSnapshots.resize(m_pFramePipeline->GetDepth());
+			m_pVehicle->SetFrameSlotCount(m_pFramePipeline->GetDepth());
+			m_pFire->SetFrameSlotCount(m_pFramePipeline->GetDepth());
 		}
 	}
 
 	Renderer::~Renderer()
 	{
-		delete m_pDepthBufferPixels;
+		// Frames still in flight use the buffers below
+		m_pFramePipeline.reset();
+
 		CleanupDirectX();
 	}
 
@@ -53,14 +123,40 @@ namespace dae {
 		if (m_IsRotating)
 		{
 			m_WorldMatrix = Matrix(Matrix::CreateRotationY(pTimer->GetElapsed() * PI / 4) * m_WorldMatrix);
+			++m_WorldMatrixVersion;
 		}
 		
 
-		// Apply transformations
+		// Apply transformations, both meshes at once
 		if (m_RenderingBackendType == RenderingBackendType::Software)
 		{
-			m_pVehicle->VertexTransformationFunction(*m_pCamera.get(), m_WorldMatrix);
-			m_pFire->VertexTransformationFunction(*m_pCamera.get(), m_WorldMatrix);
+			FrameSnapshot snapshot{ *m_pCamera.get(), m_WorldMatrix, m_WorldMatrixVersion, m_CurrentShadingMode, m_CurrentDisplayMode, m_CullingMode,
+				m_IsNormalMap, m_ToRenderFireMesh, m_IsDeferredShading, m_IsDepthPrepass, m_IsClearColorUniform, m_ShadingPrecision };
+
+			// Only the software projection follows the depth buffer's direction
+			snapshot.camera.SetReversedZ(m_pDepthBuffer->IsReversedZ());
+			snapshot.camera.CalculateProjectionMatrix();
+
+			// Same state as the frame before, it would render the same image
+			const uint64_t stateHash = snapshot.GetStateHash();
+			m_IsFrameIdle = m_IsSubmittedStateValid && stateHash == m_SubmittedStateHash;
+			if (m_IsFrameIdle) return;
+
+			m_SubmittedStateHash = stateHash;
+			m_IsSubmittedStateValid = true;
+
+			// Freeze the frame for the render stage, waits while every slot is still in flight
+			m_FrameSlot = m_pFramePipeline->AcquireSlot();
+			m_FrameSnapshots[m_FrameSlot] = snapshot;
+
+			// With a single slot the transforms are the root jobs of the frame graph instead.
+			// Deeper pipelines run them here, overlapping the render stage of the frames still in flight
+			if (m_pFramePipeline->GetDepth() > 1)
+			{
+				m_pUpdateGraph->Clear();
+				AddVertexTransforms(*m_pUpdateGraph, m_FrameSnapshots[m_FrameSlot], m_FrameSlot);
+				m_pJobSystem->Run(*m_pUpdateGraph);
+			}
 		}
 			
 	}
@@ -98,45 +194,205 @@ namespace dae {
 		m_pSwapChain->Present(0, 0);
 	}
 
-	void Renderer::RenderCPU() const
+	void Renderer::FlushFrames()
+	{
+		if (m_pFramePipeline)
+		{
+			m_pFramePipeline->Flush();
+		}
+	}
+
+	void Renderer::RenderCPU(const FrameSnapshot& snapshot, int frameSlot)
 	{
-		// Reset depth buffer and clear screen
-		std::fill(m_pDepthBufferPixels, m_pDepthBufferPixels + (m_Width * m_Height), std::numeric_limits<float>::max());
+		JobGraph& graph = *m_pFrameGraph;
+		graph.Clear();
 
 		// Clear screen with black color
-		SDL_Color clearColor;
-		if (m_IsClearColorUniform) 
+		ColorRGB clearColor;
+		if (snapshot.isClearColorUniform) 
 		{
-			clearColor = { int(0.1f * 255),  int(0.1f * 255),  int(0.1f * 255), 255 };
+			clearColor = { 0.1f, 0.1f, 0.1f };
 		}
 		else
 		{
-			clearColor = { int(0.39f * 255),  int(0.39f * 255),  int(0.39f * 255), 255 };
+			clearColor = { 0.39f, 0.39f, 0.39f };
+		}
+
+		// Nothing to transform when Update did it already
+		JobId vehicleTransform{ INVALID_JOB }, fireTransform{ INVALID_JOB };
+		if (m_pFramePipeline->GetDepth() == 1)
+		{
+			AddVertexTransforms(graph, snapshot, frameSlot, &vehicleTransform, &fireTransform);
 		}
 
-		Uint32 color = SDL_MapRGB(m_pBackBuffer->format, clearColor.r, clearColor.g, clearColor.b);
-		SDL_FillRect(m_pBackBuffer, nullptr, color);
+		// With the view and modes of the previous frame only the meshes moved, so only what they covered then and now changes.
+		// No triangle lands outside that rect, its tiles keep the pixels the window already shows
+		const JobId dirtyRectJob = graph.AddJob([this, &snapshot, frameSlot]()
+		{
+			TileRect meshBounds;
+			const bool hasMeshBounds = CalculateMeshBounds(snapshot, frameSlot, meshBounds);
+			const uint64_t viewHash = snapshot.GetViewHash();
+
+			m_DirtyRect = { 0, 0, m_Width, m_Height };
+			if (hasMeshBounds && m_HasPreviousMeshBounds && viewHash == m_PreviousViewHash)
+			{
+				m_DirtyRect = AlignToTiles(UnionRect(meshBounds, m_PreviousMeshBounds), m_Width, m_Height);
+			}
+			m_PreviousMeshBounds = meshBounds;
+			m_HasPreviousMeshBounds = hasMeshBounds;
+			m_PreviousViewHash = viewHash;
+		}, { vehicleTransform, fireTransform });
 
-		// Lock the back buffer before drawing
-		SDL_LockSurface(m_pBackBuffer);
+		// Color and depth get cleared per tile once something draws there, only the small HiZ buffer is reset up front
+		m_pTileClearState->Reset(m_Width, m_Height, clearColor);
+		const JobId clearHiZ = graph.AddJob([this]() { m_pHiZBuffer->Clear(m_pDepthBuffer->GetClearKey()); });
 
 		// RENDER LOGIC
-		m_pVehicle.get()->RenderCPU(m_Width, m_Height, m_CurrentShadingMode, m_CurrentDisplayMode, m_CullingMode, *m_pCamera.get(), m_IsNormalMap, m_pBackBuffer, m_pBackBufferPixels, m_pDepthBufferPixels);
-		if (m_ToRenderFireMesh)
+		JobId lastDraw = m_pVehicle.get()->RenderCPU(graph, vehicleTransform, { clearHiZ }, frameSlot, m_Width, m_Height, snapshot.shadingMode, snapshot.displayMode, snapshot.cullingMode, snapshot.camera, snapshot.isNormalMap, *m_pColorBuffer, *m_pDepthBuffer, *m_pHiZBuffer,
+			*m_pTileClearState, snapshot.isDeferredShading ? m_pVisibilityBuffer.get() : nullptr, false, snapshot.isDepthPrepass, snapshot.shadingPrecision);
+		if (snapshot.toRenderFireMesh)
 		{
-			if (m_CurrentShadingMode == ShadingMode::Combined && m_CurrentDisplayMode == DisplayMode::ShadingMode)
+			if (snapshot.shadingMode == ShadingMode::Combined && snapshot.displayMode == DisplayMode::ShadingMode)
 			{
-				m_pFire.get()->RenderCPU(m_Width, m_Height, m_CurrentShadingMode, m_CurrentDisplayMode, CullingMode::No, *m_pCamera.get(), false, m_pBackBuffer, m_pBackBufferPixels, m_pDepthBufferPixels);
+				// Blends over the vehicle, skipped entirely when the vehicle hides all of it
+				lastDraw = m_pFire.get()->RenderCPU(graph, fireTransform, { lastDraw }, frameSlot, m_Width, m_Height, snapshot.shadingMode, snapshot.displayMode, CullingMode::No, snapshot.camera, false, *m_pColorBuffer, *m_pDepthBuffer, *m_pHiZBuffer,
+					*m_pTileClearState, nullptr, true, false, snapshot.shadingPrecision);
 			}
 		}
-		// Unlock after rendering
-		SDL_UnlockSurface(m_pBackBuffer);
 
-		// Copy the back buffer to the front buffer for display
-		SDL_BlitSurface(m_pBackBuffer, nullptr, m_pFrontBuffer, nullptr);
+		// Every present path below writes the clear color straight into the tiles nothing was drawn into.
+		// The dirty rect is only known once the meshes are transformed, rows outside of it are skipped
+		const TileClearState* pClearState = m_pTileClearState.get();
+		const TileRect* pDirtyRect = &m_DirtyRect;
+		constexpr int presentRows{ 32 };
+		const std::vector<JobId> presentDependencies{ lastDraw, dirtyRectJob };
+
+		// Convert to 8 bits in one pass, only when not rendered there already
+		uint32_t* pFrontBufferPixels = static_cast<uint32_t*>(m_pFrontBuffer->pixels);
+		uint32_t* pResolveTarget = m_PresentMode == PresentMode::Direct ? pFrontBufferPixels : m_pBackBufferPixels;
+		if (m_pColorBuffer->IsResolveNeeded(pResolveTarget))
+		{
+			const uint32_t clearPixel = PackBGRA8(clearColor);
+			lastDraw = graph.AddParallelFor(m_Height, presentRows, [this, pResolveTarget, pClearState, pDirtyRect, clearPixel](int firstRow, int lastRow)
+			{
+				const TileRect& dirtyRect = *pDirtyRect;
+				for (int py = std::max(firstRow, dirtyRect.minY); py < std::min(lastRow, dirtyRect.maxY); ++py)
+				{
+					pClearState->ForEachRowSpan(py, dirtyRect, [&](int firstPixel, int lastPixel, bool isCleared)
+					{
+						if (isCleared) m_pColorBuffer->Resolve(firstPixel, lastPixel, pResolveTarget);
+						else std::fill(pResolveTarget + firstPixel, pResolveTarget + lastPixel, clearPixel);
+					});
+				}
+			}, presentDependencies);
+		}
+		else if (m_PresentMode != PresentMode::Convert)
+		{
+			// Rendered into the presented pixels already, only the untouched tiles are left
+			lastDraw = graph.AddParallelFor(m_Height, presentRows, [this, pClearState, pDirtyRect](int firstRow, int lastRow)
+			{
+				const TileRect& dirtyRect = *pDirtyRect;
+				for (int py = std::max(firstRow, dirtyRect.minY); py < std::min(lastRow, dirtyRect.maxY); ++py)
+				{
+					pClearState->ForEachRowSpan(py, dirtyRect, [&](int firstPixel, int lastPixel, bool isCleared)
+					{
+						if (!isCleared) m_pColorBuffer->Fill(firstPixel, lastPixel, pClearState->GetClearColor());
+					});
+				}
+			}, presentDependencies);
+		}
+
+		// Window surface with another channel order, swizzle the back buffer into it
+		if (m_PresentMode == PresentMode::Convert)
+		{
+			const SDL_PixelFormat* pFormat = m_pFrontBuffer->format;
+			const int frontPitch = m_pFrontBuffer->pitch / 4;
+
+			// Clear color in the window layout, converted once
+			const uint32_t clearPixel = PackBGRA8(clearColor);
+			uint32_t frontClearPixel;
+			ConvertBGRA8(&clearPixel, &frontClearPixel, 1, pFormat->Rshift, pFormat->Gshift, pFormat->Bshift, pFormat->Amask);
+
+			graph.AddParallelFor(m_Height, presentRows, [this, pFormat, frontPitch, pFrontBufferPixels, pClearState, pDirtyRect, frontClearPixel](int firstRow, int lastRow)
+			{
+				const TileRect& dirtyRect = *pDirtyRect;
+				for (int py = std::max(firstRow, dirtyRect.minY); py < std::min(lastRow, dirtyRect.maxY); ++py)
+				{
+					// Window rows may be padded, so spans are placed relative to the row start
+					const int rowStart = py * m_Width;
+					uint32_t* pFrontRow = pFrontBufferPixels + py * frontPitch;
+					pClearState->ForEachRowSpan(py, dirtyRect, [&](int firstPixel, int lastPixel, bool isCleared)
+					{
+						uint32_t* pDestination = pFrontRow + (firstPixel - rowStart);
+						if (isCleared) ConvertBGRA8(m_pBackBufferPixels + firstPixel, pDestination, lastPixel - firstPixel, pFormat->Rshift, pFormat->Gshift, pFormat->Bshift, pFormat->Amask);
+						else std::fill(pDestination, pDestination + (lastPixel - firstPixel), frontClearPixel);
+					});
+				}
+			}, { lastDraw, dirtyRectJob });
+		}
+
+		m_pJobSystem->Run(graph);
+	}
+
+	void Renderer::PresentCPU()
+	{
+		// Copy the back buffer to the front buffer, only for window formats we can't write ourselves
+		if (m_PresentMode == PresentMode::Blit)
+		{
+			SDL_Rect blitRect{ m_DirtyRect.minX, m_DirtyRect.minY, m_DirtyRect.maxX - m_DirtyRect.minX, m_DirtyRect.maxY - m_DirtyRect.minY };
+			SDL_BlitSurface(m_pBackBuffer, &blitRect, m_pFrontBuffer, &blitRect);
+		}
 		SDL_UpdateWindowSurface(m_pWindow);
 	}
 
+	void Renderer::AddVertexTransforms(JobGraph& graph, const FrameSnapshot& snapshot, int frameSlot, JobId* pVehicleTransform, JobId* pFireTransform)
+	{
+		const JobId vehicleTransform = m_pVehicle->VertexTransformationFunction(graph, frameSlot, snapshot.camera, snapshot.worldMatrix, snapshot.worldMatrixVersion);
+		if (pVehicleTransform) *pVehicleTransform = vehicleTransform;
+
+		// Hidden meshes aren't transformed, their slots catch up once they are shown again
+		if (snapshot.toRenderFireMesh)
+		{
+			const JobId fireTransform = m_pFire->VertexTransformationFunction(graph, frameSlot, snapshot.camera, snapshot.worldMatrix, snapshot.worldMatrixVersion);
+			if (pFireTransform) *pFireTransform = fireTransform;
+		}
+	}
+
+	bool Renderer::CalculateMeshBounds(const FrameSnapshot& snapshot, int frameSlot, TileRect& bounds) const
+	{
+		float minDepth, maxDepth;
+		if (!m_pVehicle->CalculateScreenBounds(frameSlot, m_Width, m_Height, bounds, minDepth, maxDepth)) return false;
+
+		// A hidden fire mesh isn't transformed, its slot may be out of date
+		if (snapshot.toRenderFireMesh)
+		{
+			TileRect fireBounds;
+			if (!m_pFire->CalculateScreenBounds(frameSlot, m_Width, m_Height, fireBounds, minDepth, maxDepth)) return false;
+			bounds = UnionRect(bounds, fireBounds);
+		}
+
+		// Snapping to the sub-pixel grid can move a vertex across the rounded bounds
+		bounds = { std::max(bounds.minX - 1, 0), std::max(bounds.minY - 1, 0), std::min(bounds.maxX + 1, m_Width), std::min(bounds.maxY + 1, m_Height) };
+		return true;
+	}
+
+	Renderer::PresentMode Renderer::SelectPresentMode() const
+	{
+		const SDL_PixelFormat* pFormat = m_pFrontBuffer->format;
+
+		// Every channel has to be a full byte of a 32-bit pixel
+		const bool isPacked32 = pFormat->BytesPerPixel == 4 && m_pFrontBuffer->pitch % 4 == 0 &&
+			pFormat->Rmask == 0xFFu << pFormat->Rshift && pFormat->Gmask == 0xFFu << pFormat->Gshift && pFormat->Bmask == 0xFFu << pFormat->Bshift &&
+			(pFormat->Amask == 0 || pFormat->Amask == 0xFFu << pFormat->Ashift);
+		if (!isPacked32) return PresentMode::Blit;
+
+		// Same layout as the color buffer rows (XRGB8888 or ARGB8888)
+		const bool isBGRA8 = pFormat->Rshift == 16 && pFormat->Gshift == 8 && pFormat->Bshift == 0;
+		if (isBGRA8 && m_pFrontBuffer->pitch == m_Width * 4) return PresentMode::Direct;
+
+		return PresentMode::Convert;
+	}
+
 	void Renderer::ChangeShadingMode()
 	{
 		switch (m_CurrentShadingMode)
@@ -200,12 +456,17 @@ namespace dae {
 		switch (m_RenderingBackendType)
 		{
 		case RenderingBackendType::Software:
+			FlushFrames();
 			std::cout << YELLOW << "**(SHARED)Rasterizer Mode = HARDWARE" << RESET << std::endl;
 			m_RenderingBackendType = RenderingBackendType::Hardware;
+			m_IsFrameIdle = false;
 			break;
 		case RenderingBackendType::Hardware:
 			std::cout << YELLOW << "**(SHARED)Rasterizer Mode = SOFTWARE" << RESET << std::endl;
 			m_RenderingBackendType = RenderingBackendType::Software;
+			// The window shows the hardware image now, the next software frame has to be rendered in full
+			m_IsSubmittedStateValid = false;
+			m_HasPreviousMeshBounds = false;
 			break;
 		}
 	}
@@ -253,6 +514,48 @@ namespace dae {
 		}
 	}
 
+	void Renderer::ChangeIsDeferredShading()
+	{
+		m_IsDeferredShading = !m_IsDeferredShading;
+
+		if (m_IsDeferredShading)
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Deferred Shading ON" << RESET << std::endl;
+		}
+		else
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Deferred Shading OFF" << RESET << std::endl;
+		}
+	}
+
+	void Renderer::ChangeIsDepthPrepass()
+	{
+		m_IsDepthPrepass = !m_IsDepthPrepass;
+
+		if (m_IsDepthPrepass)
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Depth Pre-Pass ON" << RESET << std::endl;
+		}
+		else
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Depth Pre-Pass OFF" << RESET << std::endl;
+		}
+	}
+
+	void Renderer::ChangeShadingPrecision()
+	{
+		m_ShadingPrecision = m_ShadingPrecision == ShadingPrecision::Exact ? ShadingPrecision::Fast : ShadingPrecision::Exact;
+
+		if (m_ShadingPrecision == ShadingPrecision::Fast)
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Fast Shading Math ON" << RESET << std::endl;
+		}
+		else
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Fast Shading Math OFF" << RESET << std::endl;
+		}
+	}
+
 	void Renderer::ChangeIsClearColorUniform()
 	{
 		m_IsClearColorUniform = !m_IsClearColorUniform;
@@ -311,7 +614,8 @@ namespace dae {
 		
 		Utils::ParseOBJ("resources/vehicle.obj", vertices, indices);
 
-		m_pVehicle = std::make_unique<Mesh3D>(m_pDevice, vertices, indices, m_pVehicleEffect.get(), false);
+		m_pVehicle = std::make_unique<Mesh3D>(m_pDevice, vertices, indices, m_pVehicleEffect.get());
+		m_pVehicle->SetSoftwareShader(std::make_shared<const VehicleShader>(*m_pVehicleEffect));
 	}
 
 	void Renderer::InitializeFire()
@@ -321,7 +625,8 @@ namespace dae {
 
 		Utils::ParseOBJ("resources/fireFX.obj", vertices, indices);
 
-		m_pFire = std::make_unique<Mesh3D>(m_pDevice, vertices, indices, m_pFireEffect.get(), true);
+		m_pFire = std::make_unique<Mesh3D>(m_pDevice, vertices, indices, m_pFireEffect.get());
+		m_pFire->SetSoftwareShader(std::make_shared<const FireShader>(*m_pFireEffect));
 	}
 
 
@@ -480,7 +785,7 @@ namespace dae {
 		}
 	}
 
-	void Renderer::Render() const
+	void Renderer::Render()
 	{
 		if (m_RenderingBackendType == RenderingBackendType::Hardware)
 		{
@@ -488,7 +793,16 @@ namespace dae {
 		}
 		else if (m_RenderingBackendType == RenderingBackendType::Software)
 		{
-			RenderCPU();
+			if (m_IsFrameIdle)
+			{
+				// The window surface still holds the last frame once it's rendered, show it again
+				FlushFrames();
+				SDL_UpdateWindowSurface(m_pWindow);
+			}
+			else
+			{
+				m_pFramePipeline->Submit(m_FrameSlot);
+			}
 		}
 	}
 
@@ -4,16 +4,54 @@
 #include "Camera.h"
 #include "FireEffect.h"
 #include "DataTypes.h"
+#include "JobSystem.h"
+#include "FramePipeline.h"
 
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
+	//Startup options of the software backend
+	struct SoftwareConfig
+	{
+		int numThreads{ 0 };							//0 uses every hardware thread
+		bool isAffinityPinned{ false };					//one core per worker thread
+		ColorFormat colorFormat{ ColorFormat::BGRA8 };
+		int pipelineDepth{ 1 };							//frames in flight, 1 renders every frame before the next update
+		PixelLayoutType pixelLayout{ PixelLayoutType::Linear };	//blocked layouts are linearized when presenting
+		bool isHugePageRequested{ false };				//for the color and depth buffers, silently falls back to normal pages
+		DepthFormat depthFormat{ DepthFormat::Float32 };
+		bool isReversedZ{ false };						//software projection only, the hardware path keeps its depth test
+		bool isDepthPlaneCompressed{ false };			//8x8 blocks covered by one triangle store its depth plane instead of pixels
+	};
+
+	//Everything the software render stage reads, frozen at the end of a frame's update
+	struct FrameSnapshot
+	{
+		Camera camera{};
+		Matrix worldMatrix{};
+		uint32_t worldMatrixVersion{};
+		ShadingMode shadingMode{};
+		DisplayMode displayMode{};
+		CullingMode cullingMode{};
+		bool isNormalMap{};
+		bool toRenderFireMesh{};
+		bool isDeferredShading{};
+		bool isDepthPrepass{};
+		bool isClearColorUniform{};
+		ShadingPrecision shadingPrecision{};
+
+		//Equal for snapshots that render the same image, the camera and world matrix enter through their versions
+		uint64_t GetStateHash() const;
+		//Same without the world matrix, equal when only the meshes moved
+		uint64_t GetViewHash() const;
+	};
+
 	class Renderer final
 	{
 	public:
-		Renderer(SDL_Window* pWindow);
+		Renderer(SDL_Window* pWindow, const SoftwareConfig& config = {});
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -23,9 +61,12 @@ namespace dae
 
 		void Update(const Timer* pTimer);
 		void CleanupDirectX();
-		void Render() const;
+		void Render();
 		void RenderGPU() const;
-		void RenderCPU() const;
+		//Blocks until every submitted software frame is presented
+		void FlushFrames();
+		//True when the last Update found the software frame state unchanged, Render then only presents the previous frame again
+		bool IsFrameIdle() const { return m_IsFrameIdle; }
 
 		void ChangeShadingMode();
 		void SetDisplayMode(DisplayMode displayMode);
@@ -37,6 +78,9 @@ namespace dae
 		void ChangeIsNormalMap();
 		void ChangeIsClearColorUniform();
 		void ChangeCullingMode();
+		void ChangeIsDeferredShading();
+		void ChangeIsDepthPrepass();
+		void ChangeShadingPrecision();
 	private:
 		SDL_Window* m_pWindow{};
 
@@ -61,14 +105,51 @@ namespace dae
 		ID3D11RenderTargetView* m_pRenderTargetView{};
 		
 		//Software initialization
+		//How software frames reach the window surface
+		enum class PresentMode
+		{
+			Direct,		//rendered (or resolved) straight into the window surface
+			Convert,	//32-bit window surface with another channel order, converted in parallel
+			Blit		//anything else goes through SDL
+		};
+		PresentMode m_PresentMode{ PresentMode::Blit };
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
-		float* m_pDepthBufferPixels{};
+		std::unique_ptr<ColorBuffer> m_pColorBuffer;
+		std::unique_ptr<DepthBuffer> m_pDepthBuffer;
+		std::unique_ptr<HiZBuffer> m_pHiZBuffer;
+		std::unique_ptr<VisibilityBuffer> m_pVisibilityBuffer;
+		std::unique_ptr<TileClearState> m_pTileClearState;
+
+		//Every software stage runs as a job of the frame graph, only a deeper pipeline transforms in the update graph
+		std::unique_ptr<JobSystem> m_pJobSystem;
+		std::unique_ptr<JobGraph> m_pUpdateGraph;
+		std::unique_ptr<JobGraph> m_pFrameGraph;
+
+		//Render stage of a frame overlaps the updates of the next ones, each frame in flight owns a snapshot slot
+		std::unique_ptr<FramePipeline> m_pFramePipeline;
+		std::vector<FrameSnapshot> m_FrameSnapshots;
+		int m_FrameSlot{};
+
+		//State hash of the last submitted software frame, an update that reproduces it renders nothing
+		uint64_t m_SubmittedStateHash{};
+		bool m_IsSubmittedStateValid{ false };
+		bool m_IsFrameIdle{ false };
+
+		//Screen rect the meshes covered in the last rendered frame. With an unchanged view the next frame only redraws
+		//its union with their new rect, only touched by the render stage
+		TileRect m_PreviousMeshBounds{};
+		bool m_HasPreviousMeshBounds{ false };
+		uint64_t m_PreviousViewHash{};
+		//Rect the frame being rendered redraws, written by a job of its graph. The next frame only renders once it's presented
+		TileRect m_DirtyRect{};
 
 
 		//MESH
 		Matrix m_WorldMatrix{};
+		//Bumped whenever m_WorldMatrix changes, meshes keep their transformed vertices until then
+		uint32_t m_WorldMatrixVersion{};
 		std::unique_ptr<Mesh3D> m_pVehicle;
 		std::unique_ptr<Mesh3D> m_pFire;
 
@@ -81,6 +162,9 @@ namespace dae
 		bool m_IsNormalMap{ true };
 		bool m_IsRotating{ true };
 		bool m_ToRenderFireMesh{ true };
+		bool m_IsDeferredShading{ false };
+		bool m_IsDepthPrepass{ false };
+		ShadingPrecision m_ShadingPrecision{ ShadingPrecision::Exact };
 
 
 		bool m_IsClearColorUniform{ false };
@@ -88,6 +172,14 @@ namespace dae
 		std::unique_ptr<VehicleEffect> m_pVehicleEffect;
 		std::unique_ptr<FireEffect> m_pFireEffect;
 
+		PresentMode SelectPresentMode() const;
+		void RenderCPU(const FrameSnapshot& snapshot, int frameSlot);
+		//Shows the last rendered frame, always called on the thread owning the window
+		void PresentCPU();
+		//Vertex transforms of every mesh the snapshot draws, INVALID_JOB is left for meshes that are up to date or hidden
+		void AddVertexTransforms(JobGraph& graph, const FrameSnapshot& snapshot, int frameSlot, JobId* pVehicleTransform = nullptr, JobId* pFireTransform = nullptr);
+		//Screen rect of every mesh the snapshot draws, false when one of them can't be bounded
+		bool CalculateMeshBounds(const FrameSnapshot& snapshot, int frameSlot, TileRect& bounds) const;
 		void InitializeVehicle();
 		void InitializeFire();
 	};
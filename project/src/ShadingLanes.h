@@ -0,0 +1,142 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+
+namespace dae
+{
+	//Pixel shading runs SoA over SHADING_LANES pixels at a time. SSE is part of every x64 CPU,
+	//so unlike the raster kernels the shading math needs no dispatch per instruction set
+	constexpr int SHADING_LANES{ 4 };
+	//Covered pixels of a triangle are collected until a batch is full, then shaded together
+	constexpr int SHADING_BATCH_SIZE{ 2 * SHADING_LANES };
+
+	//One float per pixel. Every operation is the IEEE one the scalar ColorRGB/Vector3 math does, so results match it bit for bit
+	struct FloatLanes
+	{
+		__m128 value;
+
+		FloatLanes() : value(_mm_setzero_ps()) {}
+		FloatLanes(__m128 lanes) : value(lanes) {}
+		FloatLanes(float scalar) : value(_mm_set1_ps(scalar)) {}
+
+		static FloatLanes Load(const float* pValues) { return _mm_load_ps(pValues); }
+		void Store(float* pValues) const { _mm_store_ps(pValues, value); }
+	};
+
+	inline FloatLanes operator+(const FloatLanes& a, const FloatLanes& b) { return _mm_add_ps(a.value, b.value); }
+	inline FloatLanes operator-(const FloatLanes& a, const FloatLanes& b) { return _mm_sub_ps(a.value, b.value); }
+	inline FloatLanes operator*(const FloatLanes& a, const FloatLanes& b) { return _mm_mul_ps(a.value, b.value); }
+	inline FloatLanes operator/(const FloatLanes& a, const FloatLanes& b) { return _mm_div_ps(a.value, b.value); }
+	inline FloatLanes operator-(const FloatLanes& a) { return _mm_xor_ps(a.value, _mm_set1_ps(-0.f)); }
+
+	//Comparisons give all bits set in the lanes where they hold
+	inline FloatLanes operator<(const FloatLanes& a, const FloatLanes& b) { return _mm_cmplt_ps(a.value, b.value); }
+	inline FloatLanes operator>(const FloatLanes& a, const FloatLanes& b) { return _mm_cmpgt_ps(a.value, b.value); }
+	inline FloatLanes operator==(const FloatLanes& a, const FloatLanes& b) { return _mm_cmpeq_ps(a.value, b.value); }
+	inline int ToLaneBits(const FloatLanes& mask) { return _mm_movemask_ps(mask.value); }
+	//Lanes of a where mask is set, of b elsewhere
+	inline FloatLanes Select(const FloatLanes& mask, const FloatLanes& a, const FloatLanes& b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask.value, a.value), _mm_andnot_ps(mask.value, b.value));
+	}
+
+	inline FloatLanes Sqrt(const FloatLanes& a) { return _mm_sqrt_ps(a.value); }
+	//Same as std::max(a, 0.f) and std::clamp(a, 0.f, 1.f), signed zeros and NaN included
+	inline FloatLanes MaxZero(const FloatLanes& a) { return _mm_max_ps(_mm_setzero_ps(), a.value); }
+	inline FloatLanes Clamp01(const FloatLanes& a) { return _mm_min_ps(_mm_set1_ps(1.f), MaxZero(a).value); }
+	//There is no SSE pow, lanes go through powf one by one
+	inline FloatLanes Pow(const FloatLanes& base, const FloatLanes& exponent)
+	{
+		alignas(16) float bases[SHADING_LANES];
+		alignas(16) float exponents[SHADING_LANES];
+		base.Store(bases);
+		exponent.Store(exponents);
+		for (int lane = 0; lane < SHADING_LANES; ++lane)
+		{
+			bases[lane] = std::powf(bases[lane], exponents[lane]);
+		}
+		return FloatLanes::Load(bases);
+	}
+
+	struct Vector2Lanes
+	{
+		FloatLanes x{};
+		FloatLanes y{};
+	};
+
+	struct Vector3Lanes
+	{
+		FloatLanes x{};
+		FloatLanes y{};
+		FloatLanes z{};
+
+		Vector3Lanes Normalized() const
+		{
+			const FloatLanes magnitude = Sqrt(x * x + y * y + z * z);
+			return { x / magnitude, y / magnitude, z / magnitude };
+		}
+
+		static FloatLanes Dot(const Vector3Lanes& v1, const Vector3Lanes& v2)
+		{
+			return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+		}
+
+		static Vector3Lanes Cross(const Vector3Lanes& v1, const Vector3Lanes& v2)
+		{
+			return { v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x };
+		}
+	};
+
+	inline Vector3Lanes operator+(const Vector3Lanes& a, const Vector3Lanes& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline Vector3Lanes operator-(const Vector3Lanes& a, const Vector3Lanes& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline Vector3Lanes operator-(const Vector3Lanes& a) { return { -a.x, -a.y, -a.z }; }
+	inline Vector3Lanes operator*(const Vector3Lanes& v, const FloatLanes& scale) { return { v.x * scale, v.y * scale, v.z * scale }; }
+	inline Vector3Lanes operator*(const FloatLanes& scale, const Vector3Lanes& v) { return v * scale; }
+
+	struct ColorLanes
+	{
+		FloatLanes r{};
+		FloatLanes g{};
+		FloatLanes b{};
+	};
+
+	inline ColorLanes operator+(const ColorLanes& a, const ColorLanes& b) { return { a.r + b.r, a.g + b.g, a.b + b.b }; }
+	inline ColorLanes operator*(const ColorLanes& a, const ColorLanes& b) { return { a.r * b.r, a.g * b.g, a.b * b.b }; }
+	inline ColorLanes operator*(const ColorLanes& c, const FloatLanes& scale) { return { c.r * scale, c.g * scale, c.b * scale }; }
+	inline ColorLanes operator*(const FloatLanes& scale, const ColorLanes& c) { return c * scale; }
+	inline ColorLanes operator/(const ColorLanes& c, const FloatLanes& scale) { return { c.r / scale, c.g / scale, c.b / scale }; }
+	inline ColorLanes Select(const FloatLanes& mask, const ColorLanes& a, const ColorLanes& b)
+	{
+		return { Select(mask, a.r, b.r), Select(mask, a.g, b.g), Select(mask, a.b, b.b) };
+	}
+
+	//Perspective-correct varyings of SHADING_LANES pixels, the SoA counterpart of the Vertex_Out attributes
+	struct VaryingLanes
+	{
+		Vector2Lanes uv{};
+		Vector3Lanes normal{};
+		Vector3Lanes tangent{};
+		Vector3Lanes viewDirection{};
+	};
+
+	//Pixels of one triangle that passed the depth test and wait to be shaded
+	struct FragmentBatch
+	{
+		alignas(16) int pixelIndices[SHADING_BATCH_SIZE]{};
+		alignas(16) float weights0[SHADING_BATCH_SIZE]{};
+		alignas(16) float weights1[SHADING_BATCH_SIZE]{};
+		alignas(16) float depths[SHADING_BATCH_SIZE]{};
+		int count{};
+
+		//Returns true once the batch is full
+		bool Add(int pixelIndex, float weight0, float weight1, float depth)
+		{
+			pixelIndices[count] = pixelIndex;
+			weights0[count] = weight0;
+			weights1[count] = weight1;
+			depths[count] = depth;
+			return ++count == SHADING_BATCH_SIZE;
+		}
+	};
+}
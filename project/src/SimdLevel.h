@@ -0,0 +1,23 @@
+#pragma once
+
+//MSVC accepts any intrinsic in any function, GCC/Clang need the instruction set enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define DAE_TARGET_SSE41
+#define DAE_TARGET_AVX2
+#else
+#define DAE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define DAE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace dae
+{
+	enum class SimdLevel
+	{
+		Scalar,
+		SSE41,
+		AVX2
+	};
+
+	//Detected once from the CPU features, the widest supported kernel is used
+	SimdLevel GetSimdLevel();
+}
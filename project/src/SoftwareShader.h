@@ -0,0 +1,35 @@
+#pragma once
+#include <concepts>
+#include <cstdint>
+#include "DataTypes.h"
+#include "Matrix.h"
+#include "Rasterizer.h"
+#include "VertexStreams.h"
+using namespace dae;
+
+//Per-draw inputs of the vertex stage, the same for every vertex of the mesh
+struct VertexConstants
+{
+	Matrix world{};
+	Matrix worldViewProjection{};
+	Vector3 cameraOrigin{};
+};
+
+//CPU counterpart of an effect. The software rasterizer is instantiated per shader type, so both stages inline into its loops
+//and a new material costs the other ones nothing. A shader declares:
+//	IS_TRANSPARENT					blends over the target instead of writing depth
+//	GetVaryings(shadingMode, ...)	Vertex_Out attributes its pixel stage reads (VertexAttributeFlags), only these get interpolated
+//	HasNormalMap()					whether normal mapped variants can be used at all
+//	ShadeVertices(vertices, first, last, constants, out)	clip space positions plus the varyings of the range [first, last),
+//		written stream by stream with the batched Matrix transforms
+//	ShadePixels<shadingMode, isNormalMap, precision>(varyings, target)	colors of SHADING_LANES pixels from their interpolated varyings,
+//		target is the clamped color underneath for transparent shaders and black otherwise, precision picks the ShadingMath tier
+template<typename Shader>
+concept SoftwareShader = requires(const Shader& shader, const VertexStreams& vertices, const VertexConstants& constants, VertexStreams_Out& out, VaryingLanes& varyings, const ColorLanes& target)
+{
+	{ Shader::IS_TRANSPARENT } -> std::convertible_to<bool>;
+	{ Shader::GetVaryings(ShadingMode::Combined, false) } -> std::same_as<uint32_t>;
+	{ shader.HasNormalMap() } -> std::same_as<bool>;
+	shader.ShadeVertices(vertices, 0, 0, constants, out);
+	{ shader.template ShadePixels<ShadingMode::Combined, false, ShadingPrecision::Exact>(varyings, target) } -> std::same_as<ColorLanes>;
+};
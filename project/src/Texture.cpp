@@ -13,6 +13,11 @@ namespace dae
 		m_pSurface = pSurface;
 		m_pSurfacePixels = (uint32_t*)pSurface->pixels;
 
+		const SDL_PixelFormat* pFormat = pSurface->format;
+		const auto isByteChannel = [](uint32_t mask, uint8_t shift) { return mask == (0xFFu << shift); };
+		m_IsByteFormat = pFormat->BytesPerPixel == 4 && isByteChannel(pFormat->Rmask, pFormat->Rshift) && isByteChannel(pFormat->Gmask, pFormat->Gshift) &&
+			isByteChannel(pFormat->Bmask, pFormat->Bshift) && (pFormat->Amask == 0 || isByteChannel(pFormat->Amask, pFormat->Ashift));
+
 		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		D3D11_TEXTURE2D_DESC desc{};
 		desc.Width = pSurface->w;
@@ -116,4 +121,51 @@ namespace dae
 
 		return{ float(r) / 255.f, float(g) / 255.f, float(b) / 255.f, float(a) / 255.f };
 	}
+
+	ColorLanes Texture::SampleLanes(const Vector2Lanes& uv) const
+	{
+		FloatLanes alpha;
+		return SampleLanes(uv, alpha);
+	}
+
+	ColorLanes Texture::SampleLanes(const Vector2Lanes& uv, FloatLanes& alpha) const
+	{
+		alignas(16) float u[SHADING_LANES];
+		alignas(16) float v[SHADING_LANES];
+		uv.x.Store(u);
+		uv.y.Store(v);
+
+		alignas(16) int32_t channels[4][SHADING_LANES];
+		const SDL_PixelFormat* pFormat = m_pSurface->format;
+		for (int lane = 0; lane < SHADING_LANES; ++lane)
+		{
+			int x = static_cast<int>(u[lane] * m_pSurface->w);
+			int y = static_cast<int>(v[lane] * m_pSurface->h);
+
+			x = std::clamp(x, 0, m_pSurface->w - 1);
+			y = std::clamp(y, 0, m_pSurface->h - 1);
+
+			const uint32_t pixel = m_pSurfacePixels[y * m_pSurface->w + x];
+			if (m_IsByteFormat)
+			{
+				channels[0][lane] = (pixel >> pFormat->Rshift) & 0xFF;
+				channels[1][lane] = (pixel >> pFormat->Gshift) & 0xFF;
+				channels[2][lane] = (pixel >> pFormat->Bshift) & 0xFF;
+				channels[3][lane] = pFormat->Amask != 0 ? (pixel >> pFormat->Ashift) & 0xFF : 255;
+			}
+			else
+			{
+				Uint8 r, g, b, a;
+				SDL_GetRGBA(pixel, pFormat, &r, &g, &b, &a);
+				channels[0][lane] = r;
+				channels[1][lane] = g;
+				channels[2][lane] = b;
+				channels[3][lane] = a;
+			}
+		}
+
+		const auto toUnorm = [&](int channel) { return FloatLanes{ _mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(channels[channel]))) } / 255.f; };
+		alpha = toUnorm(3);
+		return { toUnorm(0), toUnorm(1), toUnorm(2) };
+	}
 }
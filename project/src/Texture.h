@@ -3,6 +3,7 @@
 #include <memory.h>
 #include "Vector2.h"
 #include "ColorRGBA.h"
+#include "ShadingLanes.h"
 namespace dae
 {
 	class Texture
@@ -18,9 +19,15 @@ namespace dae
 
 		ColorRGBA SampleWithAlpha(const Vector2& uv) const;
 
+		//Gathers the texels of SHADING_LANES pixels, same values as sampling them one by one
+		ColorLanes SampleLanes(const Vector2Lanes& uv) const;
+		ColorLanes SampleLanes(const Vector2Lanes& uv, FloatLanes& alpha) const;
+
 	private:
 		SDL_Surface* m_pSurface;
 		uint32_t* m_pSurfacePixels{ nullptr };
+		//32-bit texels with 8-bit channels are unpacked with shifts, anything else goes through SDL per texel
+		bool m_IsByteFormat{ false };
 
 		ID3D11Texture2D* m_pResource = nullptr;
 		ID3D11ShaderResourceView* m_pShaderResourceView = nullptr;
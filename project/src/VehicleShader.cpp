@@ -0,0 +1,10 @@
+#include "pch.h"
+#include "VehicleShader.h"
+
+VehicleShader::VehicleShader(VehicleEffect& effect)
+	: m_pDiffuse(effect.GetDiffuseTexture())
+	, m_pNormal(effect.GetNormalTexture())
+	, m_pGlossiness(effect.GetGlossinessTexture())
+	, m_pSpecular(effect.GetSpecularTexture())
+{
+}
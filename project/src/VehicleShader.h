@@ -0,0 +1,145 @@
+#pragma once
+#include "SoftwareShader.h"
+#include "VehicleEffect.h"
+
+//CPU counterpart of VehicleEffect (PosCol3D.fx): normal mapped Lambert diffuse and Phong specular under one directional light
+class VehicleShader final
+{
+public:
+	static constexpr bool IS_TRANSPARENT{ false };
+
+	//Textures are owned by the effect, which has to outlive the shader
+	explicit VehicleShader(VehicleEffect& effect);
+
+	static uint32_t GetVaryings(ShadingMode shadingMode, bool isNormalMap)
+	{
+		uint32_t varyings = AttributeNormal;
+		if (isNormalMap)
+		{
+			varyings |= AttributeUV | AttributeTangent;
+		}
+		if (shadingMode != ShadingMode::ObservedArea)
+		{
+			varyings |= AttributeUV;
+		}
+		if (shadingMode == ShadingMode::Specular || shadingMode == ShadingMode::Combined)
+		{
+			varyings |= AttributeViewDirection;
+		}
+		return varyings;
+	}
+
+	bool HasNormalMap() const { return m_pNormal != nullptr; }
+
+	void ShadeVertices(const VertexStreams& vertices, int first, int last, const VertexConstants& constants, VertexStreams_Out& out) const
+	{
+		constants.world.TransformVectors(vertices.normal, out.normal, first, last);
+		out.normal.Normalize(first, last);
+		constants.world.TransformVectors(vertices.tangent, out.tangent, first, last);
+		out.tangent.Normalize(first, last);
+
+		// World positions go straight into the view directions, which are their normalized offset from the camera
+		constants.world.TransformPoints(vertices.position, out.viewDirection, first, last);
+		out.viewDirection.Normalize(first, last, constants.cameraOrigin);
+
+		// Stays in clip space, the rasterizer clips before dividing by w
+		constants.worldViewProjection.TransformPoints(vertices.position, out.position, first, last);
+		out.uv.Assign(vertices.uv, first, last);
+	}
+
+	template<ShadingMode shadingMode, bool isNormalMap, ShadingPrecision precision>
+	ColorLanes ShadePixels(VaryingLanes& v, const ColorLanes& /*target*/) const
+	{
+		using Math = ShadingMath<precision>;
+		ColorLanes finalColor;
+
+		const Vector3Lanes lightDirection = { .577f, -.577f,  .577f };
+		constexpr float lightIntensity = 7.f;
+		constexpr float shininess = 25.f;
+		const ColorLanes ambient = { .025f,.025f,.025f };
+
+		if constexpr (isNormalMap)
+		{
+			const Vector3Lanes binormal = Vector3Lanes::Cross(v.normal, v.tangent);
+			const ColorLanes normalMapSample = m_pNormal->SampleLanes(v.uv);
+			v.normal = Math::Normalized(v.tangent * (2.f * normalMapSample.r - 1.f) + binormal * (2.f * normalMapSample.g - 1.f) + v.normal * (2.f * normalMapSample.b - 1.f));
+		}
+
+		// Faces turned away from the light stay black, the lanes are only masked at the end
+		const FloatLanes cosOfAngle{ Vector3Lanes::Dot(v.normal, -lightDirection) };
+		const ColorLanes observedArea = { cosOfAngle, cosOfAngle, cosOfAngle };
+
+		// Only sample what the shading mode combines, the other varyings were not interpolated
+		constexpr bool isDiffuseUsed = shadingMode == ShadingMode::Diffuse || shadingMode == ShadingMode::Combined;
+		constexpr bool isSpecularUsed = shadingMode == ShadingMode::Specular || shadingMode == ShadingMode::Combined;
+
+		ColorLanes diffuse;
+		if (isDiffuseUsed && m_pDiffuse != nullptr)
+		{
+			diffuse = Lambert(m_pDiffuse->SampleLanes(v.uv));
+		}
+
+		ColorLanes gloss;
+		if (isSpecularUsed && m_pGlossiness != nullptr)
+		{
+			gloss = m_pGlossiness->SampleLanes(v.uv);
+		}
+
+		const FloatLanes exp = gloss.r * shininess;
+
+		ColorLanes specular;
+		if (isSpecularUsed && m_pSpecular != nullptr)
+		{
+			specular = Phong<precision>(m_pSpecular->SampleLanes(v.uv), exp, -lightDirection, v.viewDirection, v.normal);
+		}
+
+		if constexpr (shadingMode == ShadingMode::ObservedArea)
+		{
+			finalColor = observedArea;
+		}
+		else if constexpr (shadingMode == ShadingMode::Diffuse)
+		{
+			finalColor = diffuse * observedArea * lightIntensity;
+		}
+		else if constexpr (shadingMode == ShadingMode::Specular)
+		{
+			finalColor = specular;
+		}
+		else
+		{
+			finalColor = ambient + specular + diffuse * observedArea * lightIntensity;
+		}
+
+		return Select(cosOfAngle < 0.f, ColorLanes{}, finalColor);
+	}
+
+	//Materials formulas
+	static ColorLanes Lambert(const ColorLanes& cd, const FloatLanes& kd = 1.f)
+	{
+		const ColorLanes rho = kd * cd;
+		return rho / PI;
+	}
+
+	static ColorLanes Lambert(const ColorLanes& cd, const ColorLanes& kd)
+	{
+		const ColorLanes rho = kd * cd;
+		return rho / PI;
+	}
+
+	template<ShadingPrecision precision = ShadingPrecision::Exact>
+	static ColorLanes Phong(const ColorLanes& ks, const FloatLanes& exp, const Vector3Lanes& l, const Vector3Lanes& v, const Vector3Lanes& n)
+	{
+		const Vector3Lanes reflect = l - (2.f * MaxZero(Vector3Lanes::Dot(n, l)) * n);
+		const FloatLanes cosAlpha = MaxZero(Vector3Lanes::Dot(reflect, v));
+
+		return ks * ShadingMath<precision>::Pow(cosAlpha, exp);
+	}
+
+private:
+	const Texture* m_pDiffuse{};
+	const Texture* m_pNormal{};
+	const Texture* m_pGlossiness{};
+	const Texture* m_pSpecular{};
+};
+
+static_assert(SoftwareShader<VehicleShader>);
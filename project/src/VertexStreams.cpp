@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "VertexStreams.h"
+#include "Rasterizer.h"
+#include "SimdLevel.h"
+#include <algorithm>
+#include <immintrin.h>
+
+namespace
+{
+	//Normalizes VERTEX_LANES vectors per iteration and returns how many it did, the rest is left to the scalar loop.
+	//Same operations in the same order as Vector3::Normalized, so results match it bit for bit
+	DAE_TARGET_AVX2 int NormalizeAVX2(float* pX, float* pY, float* pZ, int count, const dae::Vector3& origin)
+	{
+		const __m256 originX = _mm256_set1_ps(origin.x);
+		const __m256 originY = _mm256_set1_ps(origin.y);
+		const __m256 originZ = _mm256_set1_ps(origin.z);
+
+		int index = 0;
+		for (; index + dae::VERTEX_LANES <= count; index += dae::VERTEX_LANES)
+		{
+			const __m256 x = _mm256_sub_ps(_mm256_loadu_ps(pX + index), originX);
+			const __m256 y = _mm256_sub_ps(_mm256_loadu_ps(pY + index), originY);
+			const __m256 z = _mm256_sub_ps(_mm256_loadu_ps(pZ + index), originZ);
+
+			const __m256 magnitude = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+			_mm256_storeu_ps(pX + index, _mm256_div_ps(x, magnitude));
+			_mm256_storeu_ps(pY + index, _mm256_div_ps(y, magnitude));
+			_mm256_storeu_ps(pZ + index, _mm256_div_ps(z, magnitude));
+		}
+		return index;
+	}
+}
+
+namespace dae
+{
+	void Vector2Stream::Resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+	}
+
+	void Vector2Stream::Assign(const Vector2Stream& other, int first, int last)
+	{
+		std::copy(other.x.begin() + first, other.x.begin() + last, x.begin() + first);
+		std::copy(other.y.begin() + first, other.y.begin() + last, y.begin() + first);
+	}
+
+	void Vector3Stream::Resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+	}
+
+	void Vector3Stream::Normalize(int first, int last, const Vector3& origin)
+	{
+		int index = first;
+		if (GetSimdLevel() == SimdLevel::AVX2)
+		{
+			index += NormalizeAVX2(x.data() + first, y.data() + first, z.data() + first, last - first, origin);
+		}
+
+		for (; index < last; ++index)
+		{
+			const Vector3 normalized = (Vector3{ x[index], y[index], z[index] } - origin).Normalized();
+			x[index] = normalized.x;
+			y[index] = normalized.y;
+			z[index] = normalized.z;
+		}
+	}
+
+	void Vector4Stream::Resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		w.resize(count);
+	}
+
+	void VertexStreams::Assign(const std::vector<Vertex>& vertices)
+	{
+		position.Resize(vertices.size());
+		uv.Resize(vertices.size());
+		normal.Resize(vertices.size());
+		tangent.Resize(vertices.size());
+
+		for (size_t index = 0; index < vertices.size(); ++index)
+		{
+			const Vertex& vertex = vertices[index];
+			position.x[index] = vertex.position.x;
+			position.y[index] = vertex.position.y;
+			position.z[index] = vertex.position.z;
+			uv.x[index] = vertex.uv.x;
+			uv.y[index] = vertex.uv.y;
+			normal.x[index] = vertex.normal.x;
+			normal.y[index] = vertex.normal.y;
+			normal.z[index] = vertex.normal.z;
+			tangent.x[index] = vertex.tangent.x;
+			tangent.y[index] = vertex.tangent.y;
+			tangent.z[index] = vertex.tangent.z;
+		}
+	}
+
+	void VertexStreams_Out::Resize(size_t count)
+	{
+		position.Resize(count);
+		uv.Resize(count);
+		normal.Resize(count);
+		tangent.Resize(count);
+		viewDirection.Resize(count);
+	}
+
+	void VertexStreams_Out::Gather(uint32_t index, uint32_t attributes, Vertex_Out& vertex) const
+	{
+		vertex.position = { position.x[index], position.y[index], position.z[index], position.w[index] };
+
+		if (attributes & AttributeUV)
+		{
+			vertex.uv = { uv.x[index], uv.y[index] };
+		}
+		if (attributes & AttributeNormal)
+		{
+			vertex.normal = { normal.x[index], normal.y[index], normal.z[index] };
+		}
+		if (attributes & AttributeTangent)
+		{
+			vertex.tangent = { tangent.x[index], tangent.y[index], tangent.z[index] };
+		}
+		if (attributes & AttributeViewDirection)
+		{
+			vertex.viewDirection = { viewDirection.x[index], viewDirection.y[index], viewDirection.z[index] };
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Vertices are processed VERTEX_LANES at a time, one AVX2 register per component
+	constexpr int VERTEX_LANES{ 8 };
+
+	//Structure-of-arrays counterparts of the vector types, one float stream per component
+	struct Vector2Stream
+	{
+		std::vector<float> x{};
+		std::vector<float> y{};
+
+		void Resize(size_t count);
+		//Copies the vectors in [first, last) of other into the same range
+		void Assign(const Vector2Stream& other, int first, int last);
+	};
+
+	struct Vector3Stream
+	{
+		std::vector<float> x{};
+		std::vector<float> y{};
+		std::vector<float> z{};
+
+		void Resize(size_t count);
+		//Replaces the vectors in [first, last) by their normalized offset from origin, bit for bit what Vector3::Normalized gives
+		void Normalize(int first, int last, const Vector3& origin = {});
+	};
+
+	struct Vector4Stream
+	{
+		std::vector<float> x{};
+		std::vector<float> y{};
+		std::vector<float> z{};
+		std::vector<float> w{};
+
+		void Resize(size_t count);
+	};
+
+	//Mesh vertices as streams, built once so the vertex stage never has to transpose them
+	struct VertexStreams
+	{
+		Vector3Stream position{};
+		Vector2Stream uv{};
+		Vector3Stream normal{};
+		Vector3Stream tangent{};
+
+		void Assign(const std::vector<Vertex>& vertices);
+		int GetCount() const { return int(position.x.size()); }
+	};
+
+	//Post-transform cache, the structure-of-arrays counterpart of Vertex_Out.
+	//Shaders only fill the streams they output, the others stay zero
+	struct VertexStreams_Out
+	{
+		Vector4Stream position{};
+		Vector2Stream uv{};
+		Vector3Stream normal{};
+		Vector3Stream tangent{};
+		Vector3Stream viewDirection{};
+
+		void Resize(size_t count);
+		int GetCount() const { return int(position.x.size()); }
+		//Assembles one vertex for clipping and triangle setup, only the position and the requested attributes (VertexAttributeFlags) are read
+		void Gather(uint32_t index, uint32_t attributes, Vertex_Out& vertex) const;
+	};
+}
@@ -6,6 +6,8 @@
 
 #undef main
 #include "Renderer.h"
+#include <cstdlib>
+#include <string>
 
 using namespace dae;
 
@@ -25,6 +27,61 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+//Startup options of the software backend, unknown arguments are reported and skipped
+SoftwareConfig ParseSoftwareConfig(int argc, char* args[])
+{
+	SoftwareConfig config{};
+	for (int index = 1; index < argc; ++index)
+	{
+		const std::string argument{ args[index] };
+		if (argument == "--threads" && index + 1 < argc)
+		{
+			config.numThreads = std::max(std::atoi(args[++index]), 0);
+		}
+		else if (argument == "--pin-threads")
+		{
+			config.isAffinityPinned = true;
+		}
+		else if (argument == "--pipeline" && index + 1 < argc)
+		{
+			config.pipelineDepth = std::max(std::atoi(args[++index]), 1);
+		}
+		else if (argument == "--rgba16f")
+		{
+			config.colorFormat = ColorFormat::RGBA16F;
+		}
+		else if (argument == "--blocked")
+		{
+			config.pixelLayout = PixelLayoutType::Blocked8x8;
+		}
+		else if (argument == "--huge-pages")
+		{
+			config.isHugePageRequested = true;
+		}
+		else if (argument == "--depth16")
+		{
+			config.depthFormat = DepthFormat::Unorm16;
+		}
+		else if (argument == "--depth24")
+		{
+			config.depthFormat = DepthFormat::Unorm24;
+		}
+		else if (argument == "--reversed-z")
+		{
+			config.isReversedZ = true;
+		}
+		else if (argument == "--depth-planes")
+		{
+			config.isDepthPlaneCompressed = true;
+		}
+		else
+		{
+			std::cout << "Unknown argument " << argument << std::endl;
+		}
+	}
+	return config;
+}
+
 
 
 
@@ -50,11 +107,23 @@ int main(int argc, char* args[])
 	std::cout << MAGENTA << "   [F5]  Cycle Shading Mode (COMBINED/OBSERVED_AREA/DIFFUSE/SPECULAR)" << RESET << std::endl;
 	std::cout << MAGENTA << "   [F6]  Toggle NormalMap (ON/OFF)"									<< RESET << std::endl;
 	std::cout << MAGENTA << "   [F7]  Toggle DepthBuffer Visualization (ON/OFF)"					<< RESET << std::endl;
-	std::cout << MAGENTA << "   [F8]  Toggle BoundingBox Visualization (ON/OFF)"					<< RESET << std::endl << "\n" << "\n";
+	std::cout << MAGENTA << "   [F8]  Toggle BoundingBox Visualization (ON/OFF)"					<< RESET << std::endl;
+	std::cout << MAGENTA << "   [F12] Toggle Deferred Shading (ON/OFF)"								<< RESET << std::endl;
+	std::cout << MAGENTA << "   [Z]   Toggle Depth Pre-Pass (ON/OFF)"									<< RESET << std::endl;
+	std::cout << MAGENTA << "   [X]   Toggle Fast Shading Math (ON/OFF)"								<< RESET << std::endl << "\n";
+
+	std::cout << MAGENTA << "[Startup Options - SOFTWARE]"											<< RESET << std::endl;
+	std::cout << MAGENTA << "   --threads N     Worker Threads, Including The Main Thread (0 = ALL)"	<< RESET << std::endl;
+	std::cout << MAGENTA << "   --pin-threads   Pin Every Worker Thread To One Core"					<< RESET << std::endl;
+	std::cout << MAGENTA << "   --pipeline N    Frames In Flight, Above 1 Renders On Its Own Thread"	<< RESET << std::endl;
+	std::cout << MAGENTA << "   --rgba16f       Half Float Color Buffer, Resolved To 8 Bits On Present"	<< RESET << std::endl;
+	std::cout << MAGENTA << "   --blocked       8x8 Blocked Color/Depth Layout"						<< RESET << std::endl;
+	std::cout << MAGENTA << "   --huge-pages    Color/Depth Buffers On Huge Pages When Available"		<< RESET << std::endl;
+	std::cout << MAGENTA << "   --depth16       16-Bit Unorm Depth Buffer (--depth24 For 24-Bit)"		<< RESET << std::endl;
+	std::cout << MAGENTA << "   --reversed-z    Reversed-Z Software Projection"						<< RESET << std::endl;
+	std::cout << MAGENTA << "   --depth-planes  Store Depth Planes For 8x8 Blocks Covered By One Triangle" << RESET << std::endl << "\n" << "\n";
 
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	const SoftwareConfig softwareConfig = ParseSoftwareConfig(argc, args);
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -73,7 +142,7 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = new Renderer(pWindow, softwareConfig);
 
 	//Start loop
 	pTimer->Start();
@@ -82,6 +151,17 @@ int main(int argc, char* args[])
 	bool printFPS = false;
 	while (isLooping)
 	{
+		//--------- Wait while idle ---------
+		//Nothing changed last frame, sleep until input arrives instead of presenting the same frame again.
+		//The timer is paused meanwhile so the wait doesn't count as elapsed time
+		if (pRenderer->IsFrameIdle())
+		{
+			constexpr int idleWaitMs{ 100 };
+			pTimer->Stop();
+			SDL_WaitEventTimeout(nullptr, idleWaitMs);
+			pTimer->Start();
+		}
+
 		//--------- Get input events ---------
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
@@ -152,6 +232,18 @@ int main(int argc, char* args[])
 					}
 					
 				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+				{
+					pRenderer->ChangeIsDeferredShading();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_Z)
+				{
+					pRenderer->ChangeIsDepthPrepass();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_X)
+				{
+					pRenderer->ChangeShadingPrecision();
+				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
 				{
 					pRenderer->ChangeCullingMode();